@@ -1,59 +1,26 @@
+#include "runnables.hpp"
 #include <thread>
 #include <iostream>
 #include <functional>
 #include <system_error>
 #include <iomanip>
 
-/** */
-template <typename Runnable>
-class gthread
-  : public std::thread
-{
-public:
-  explicit gthread ( Runnable&& r )
-    : std::thread(), m_task(std::move(r))
-  { dynamic_cast<std::thread&>(*this) = std::thread(&Runnable::operator(),&m_task); }
-private:
-  Runnable m_task;
-};
-
-/** */
-class othread
-        : public std::thread
-{
-public:
-        template <typename Runnable>
-        explicit othread ( Runnable&& r )
-                : std::thread(), m_task(new Runnable(std::move(r)))
-        { dynamic_cast<std::thread&>(*this) = std::thread(&Runnable::operator(),static_cast<Runnable*>(m_task)); }
-private:
-        void* m_task;
-};
-
-/** */
-class runnable
-  : public std::thread
-{
-public:
-  virtual void operator() () = 0;
-  virtual void run() final { dynamic_cast<std::thread&>(*this) = std::thread(&runnable::operator(),this); }
-};
-
-
 class DerivedThread : public std::thread
 {
 public:
-  DerivedThread() : std::thread() {}
-  void operator() () { while (true) { std::cerr << get_id() << '\n'; } }
+  explicit DerivedThread ( stop_token t = stop_token() ) : std::thread(), stop(t) {}
+  void operator() () { while (!stop.expired()) { std::cerr << get_id() << '\n'; } }
   void start() { dynamic_cast<std::thread&>(*this) = std::thread(std::mem_fn(&DerivedThread::operator()),this); }
+private:
+  stop_token stop;
 };
 
 class DerivedThread2 : public runnable
 {
 public:
-  DerivedThread2 () {}
-  DerivedThread2 ( DerivedThread2 && t ) {}
-  void operator() () { while (true) { std::cerr << get_id() << '\n'; } }
+  explicit DerivedThread2 ( stop_token t = stop_token() ) : runnable(t) {}
+  DerivedThread2 ( DerivedThread2 && t ) : runnable(t.stop()) {}
+  void operator() () { while (!stop_requested()) { std::cerr << get_id() << '\n'; } }
   void setOther(std::shared_ptr<DerivedThread2> t) { other = t; }
 private:
   std::shared_ptr<DerivedThread2> other;
@@ -66,12 +33,15 @@ int main()
   //DerivedThread t3;
   //DerivedThread2 t4;
 
-  std::shared_ptr<DerivedThread2> t1 {new DerivedThread2};
-  std::shared_ptr<DerivedThread2> t2 {new DerivedThread2};
-  std::shared_ptr<DerivedThread2> t3 {new DerivedThread2};
-  std::shared_ptr<DerivedThread2> t4 {new DerivedThread2};
-  std::shared_ptr<DerivedThread2> t5 {new DerivedThread2};
-  std::shared_ptr<DerivedThread2> t6 {new DerivedThread2};
+  // all six share one token, which expires after a tenth of a second
+  stop_token stop;
+  stop.time_limit(0.1);
+  std::shared_ptr<DerivedThread2> t1 {new DerivedThread2(stop)};
+  std::shared_ptr<DerivedThread2> t2 {new DerivedThread2(stop)};
+  std::shared_ptr<DerivedThread2> t3 {new DerivedThread2(stop)};
+  std::shared_ptr<DerivedThread2> t4 {new DerivedThread2(stop)};
+  std::shared_ptr<DerivedThread2> t5 {new DerivedThread2(stop)};
+  std::shared_ptr<DerivedThread2> t6 {new DerivedThread2(stop)};
 
   t1->setOther(t2);
   t2->setOther(t3);
@@ -0,0 +1,93 @@
+#include "objective.hpp"
+#include "philox.hpp"
+#include "population.hpp"
+#include "tally.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Evaluations per second with T threads each moving and evaluating its
+// own particle, counted the old way (one shared atomic counter, per-thread
+// scalars packed next to each other) and the new way (a tally, scalars in
+// a line of their own).
+//
+// benchsharing [seconds [dimensions]]
+
+namespace
+{
+
+struct packed { long long sweep; double best; };
+
+struct padded
+{
+    long long sweep;
+    double best;
+    char padding[64 - sizeof(long long) - sizeof(double)];
+};
+
+/* one thread's loop: move a particle by a random step, evaluate, keep the best */
+template <typename State, typename Count>
+void churn ( unsigned id, std::size_t d, State& mine, Count count,
+             std::atomic<bool> const& stop )
+{
+    philox rng(id);
+    griewangk f;
+    aligned_vector<double> x(d), r(d);
+    rng.fill(id, 0, philox::POSITION, x.data(), d);
+    while (!stop.load(std::memory_order_relaxed)) {
+        rng.fill(id, ++mine.sweep, philox::COGNITIVE, r.data(), d);
+        for ( std::size_t j = 0; j < d; ++j ) { x[j] += r[j] - 0.5; }
+        auto c = f(x.data(), x.data() + d);
+        if (c < mine.best) { mine.best = c; }
+        count();
+    }
+}
+
+template <typename Run>
+auto rate ( unsigned threads, double seconds, Run run ) -> double
+{
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> pool;
+    auto start = std::chrono::steady_clock::now();
+    for ( auto id = 0U; id < threads; ++id ) { pool.emplace_back(run, id, std::ref(stop)); }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop.store(true);
+    for ( auto& t : pool ) { t.join(); }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+int main (int argc, char** argv)
+{
+    double const seconds = argc > 1 ? atof(argv[1]) : 0.5;
+    std::size_t const d = argc > 2 ? atoi(argv[2]) : 8;
+
+    std::cout << "threads    shared/s    padded/s" << std::endl;
+    for ( auto threads : { 8U, 16U, 32U, 64U } ) {
+        // before: one counter for everybody, scalars side by side
+        std::vector<packed> near(threads, packed{0, 1e300});
+        std::atomic<long long> shared(0);
+        auto t0 = rate(threads, seconds, [&](unsigned id, std::atomic<bool> const& stop) {
+            churn(id, d, near[id], [&]{ shared.fetch_add(1, std::memory_order_relaxed); }, stop);
+        });
+
+        // after: a slot per thread, scalars a line apart
+        aligned_vector<padded> apart(threads);
+        for ( auto& s : apart ) { s.sweep = 0; s.best = 1e300; }
+        tally counted(threads);
+        auto t1 = rate(threads, seconds, [&](unsigned id, std::atomic<bool> const& stop) {
+            churn(id, d, apart[id], [&]{ counted.add(id); }, stop);
+        });
+
+        std::cout << std::setw(7) << threads
+                  << std::setw(12) << std::fixed << std::setprecision(0) << shared.load() / t0
+                  << std::setw(12) << counted.total() / t1 << std::endl;
+    }
+    return 0;
+}
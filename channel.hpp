@@ -0,0 +1,162 @@
+#ifndef HPP_CHANNEL
+#define HPP_CHANNEL
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/** Bounded lock-free multi-producer multi-consumer queue (Vyukov).
+ *
+ *  Each cell carries a sequence number that says whose turn it is: a
+ *  producer may fill cell c when its sequence equals the ticket it drew,
+ *  a consumer may empty it when the sequence is one past that. Both ends
+ *  claim tickets with a CAS on their own counter, so producers and
+ *  consumers never touch the same cache line except through the cell
+ *  itself. try_push/try_pop fail instead of waiting when the channel is
+ *  full/empty. Capacity is rounded up to a power of two.
+ */
+template <typename T>
+class channel
+{
+public:
+    explicit channel ( std::size_t capacity )
+        : mask(round_up(capacity) - 1), cells(new cell[mask + 1]), head(0), tail(0)
+    {
+        for ( std::size_t c = 0; c <= mask; ++c )
+            { cells[c].seq.store(c, std::memory_order_relaxed); }
+    }
+
+    channel ( channel const& ) = delete;
+    channel& operator= ( channel const& ) = delete;
+
+    auto capacity() const -> std::size_t { return mask + 1; }
+
+    bool try_push ( T const& value )
+    {
+        auto pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            auto& c = cells[pos & mask];
+            auto seq = c.seq.load(std::memory_order_acquire);
+            auto diff = std::ptrdiff_t(seq) - std::ptrdiff_t(pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    c.value = value;
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop ( T& value )
+    {
+        auto pos = head.load(std::memory_order_relaxed);
+        while (true) {
+            auto& c = cells[pos & mask];
+            auto seq = c.seq.load(std::memory_order_acquire);
+            auto diff = std::ptrdiff_t(seq) - std::ptrdiff_t(pos + 1);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = c.value;
+                    c.seq.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct cell
+    {
+        std::atomic<std::size_t> seq;
+        T value;
+    };
+
+    static auto round_up ( std::size_t n ) -> std::size_t
+    {
+        std::size_t c = 1;
+        while (c < n) { c <<= 1; }
+        return c;
+    }
+
+    std::size_t const mask;
+    std::unique_ptr<cell[]> cells;
+    char pad0[64];
+    std::atomic<std::size_t> head;
+    char pad1[64];
+    std::atomic<std::size_t> tail;
+    char pad2[64];
+};
+
+/** Bounded single-producer single-consumer ring for instrumentation.
+ *
+ *  The producer is the thread being measured, so it never waits: claim()
+ *  on a full ring counts the value as dropped and returns nullptr. A
+ *  claimed slot is filled in place and made visible by publish(); the
+ *  consumer takes everything published so far with drain(). The head
+ *  (with the drop count) and the tail sit on cache lines of their own
+ *  when the ring itself starts on one, as in an aligned_vector. Sized once
+ *  by reserve(), before either end uses it.
+ */
+template <typename T>
+class spsc_ring
+{
+public:
+    spsc_ring() : mask(0), head(0), lost(0), tail(0) {}
+
+    /** Room for `capacity` values, rounded up to a power of two. */
+    void reserve ( std::size_t capacity )
+    {
+        std::size_t c = 1;
+        while (c < capacity) { c <<= 1; }
+        values.resize(c);
+        mask = c - 1;
+    }
+
+    /** Producer: the slot for the next value, or nullptr if full. */
+    auto claim() -> T*
+    {
+        auto h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) > mask) {
+            lost.store(lost.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &values[h & mask];
+    }
+    /** Producer: hand the claimed slot to the consumer. */
+    void publish() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    /** Consumer: f(value) for everything published, oldest first. */
+    template <typename F>
+    void drain ( F f )
+    {
+        auto t = tail.load(std::memory_order_relaxed);
+        auto h = head.load(std::memory_order_acquire);
+        for ( ; t != h; ++t ) { f(values[t & mask]); }
+        tail.store(t, std::memory_order_release);
+    }
+
+    /** Values turned away because the ring was full. */
+    auto dropped() const -> long long { return lost.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<T> values;
+    std::uint64_t mask;
+    std::atomic<std::uint64_t> head;
+    std::atomic<long long> lost;
+    char padding[64 - sizeof(std::vector<T>) - sizeof(std::uint64_t) - 2 * sizeof(std::atomic<std::uint64_t>)];
+    std::atomic<std::uint64_t> tail;
+    char padding2[64 - sizeof(std::atomic<std::uint64_t>)];
+};
+
+#endif
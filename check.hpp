@@ -0,0 +1,13 @@
+#ifndef HPP_CHECK
+#define HPP_CHECK
+
+#include <iostream>
+
+/** One line per expectation of a test program: "ok   what" or "FAIL what". */
+inline bool check ( char const* what, bool ok )
+{
+    std::cout << (ok ? "ok   " : "FAIL ") << what << std::endl;
+    return ok;
+}
+
+#endif
@@ -0,0 +1,245 @@
+#ifndef HPP_CHECKPOINT
+#define HPP_CHECKPOINT
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Engine state on disk.
+ *
+ *  An engine serializes itself into an image (a flat run of bytes behind
+ *  an 8-byte magic and a version) and restores itself from a view of one.
+ *  Files are replaced atomically: the image goes to path.tmp, is synced,
+ *  and is renamed over path, so a crash leaves either the old checkpoint
+ *  or the new one, never half of either. Loading maps the file and reads
+ *  it in place.
+ */
+namespace checkpoint
+{
+
+char const MAGIC[8] = { 'P', 'S', 'O', 'C', 'K', 'P', 'T', '1' };
+std::uint32_t const VERSION = 1;
+
+inline auto invalid ( std::string const& what ) -> std::system_error
+    { return std::system_error(EINVAL, std::generic_category(), "checkpoint: " + what); }
+
+/** Bytes of one checkpoint, built by the engine on its own thread. */
+class image
+{
+public:
+    image()
+    {
+        put(MAGIC, sizeof(MAGIC));
+        put(VERSION);
+        put(std::uint32_t(0));
+    }
+
+    template <typename T>
+    void put ( T const& value ) { put(&value, sizeof(T)); }
+    void put ( void const* p, std::size_t n )
+    {
+        auto c = static_cast<char const*>(p);
+        bytes.insert(bytes.end(), c, c + n);
+    }
+
+    auto data() const -> char const* { return bytes.data(); }
+    auto size() const -> std::size_t { return bytes.size(); }
+
+private:
+    std::vector<char> bytes;
+};
+
+/** Reads back what an image put, in the same order. */
+class view
+{
+public:
+    view ( char const* p, std::size_t n ) : p(p), end(p + n)
+    {
+        char magic[sizeof(MAGIC)];
+        get(magic, sizeof(magic));
+        if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) { throw invalid("not a checkpoint"); }
+        if (get<std::uint32_t>() != VERSION) { throw invalid("unknown version"); }
+        get<std::uint32_t>();
+    }
+
+    template <typename T>
+    auto get() -> T
+    {
+        T value;
+        get(&value, sizeof(T));
+        return value;
+    }
+    void get ( void* out, std::size_t n )
+    {
+        if (std::size_t(end - p) < n) { throw invalid("truncated"); }
+        std::memcpy(out, p, n);
+        p += n;
+    }
+
+private:
+    char const* p;
+    char const* end;
+};
+
+/** A checkpoint file mapped read-only. */
+class file
+{
+public:
+    explicit file ( std::string const& path ) : base(nullptr), length(0)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) { throw std::system_error(errno, std::generic_category(), path); }
+        struct stat st;
+        auto e = ::fstat(fd, &st) != 0 ? errno : st.st_size == 0 ? EINVAL : 0;
+        if (e) {
+            ::close(fd);
+            throw std::system_error(e, std::generic_category(), path);
+        }
+        length = std::size_t(st.st_size);
+        auto p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) { throw std::system_error(errno, std::generic_category(), path); }
+        base = static_cast<char const*>(p);
+    }
+
+    file ( file const& ) = delete;
+    file& operator= ( file const& ) = delete;
+    ~file() { ::munmap(const_cast<char*>(base), length); }
+
+    auto contents() const -> view { return view(base, length); }
+
+private:
+    char const* base;
+    std::size_t length;
+};
+
+/** Write img to path atomically: a temporary, fsync, rename, and a sync
+ *  of the directory so the rename itself survives a crash. */
+inline void write ( std::string const& path, image const& img )
+{
+    auto tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) { throw std::system_error(errno, std::generic_category(), tmp); }
+    auto p = img.data();
+    auto n = img.size();
+    while (n > 0) {
+        auto w = ::write(fd, p, n);
+        if (w < 0 && errno == EINTR) { continue; }
+        if (w <= 0) {
+            auto e = errno;
+            ::close(fd);
+            ::unlink(tmp.c_str());
+            throw std::system_error(e, std::generic_category(), tmp);
+        }
+        p += w;
+        n -= std::size_t(w);
+    }
+    if (::fsync(fd) != 0 || ::close(fd) != 0) {
+        auto e = errno;
+        ::unlink(tmp.c_str());
+        throw std::system_error(e, std::generic_category(), tmp);
+    }
+    if (::rename(tmp.c_str(), path.c_str()) != 0) {
+        auto e = errno;
+        ::unlink(tmp.c_str());
+        throw std::system_error(e, std::generic_category(), path);
+    }
+    auto slash = path.rfind('/');
+    auto dir = slash == std::string::npos ? std::string(".") : path.substr(0, slash + 1);
+    int d = ::open(dir.c_str(), O_RDONLY);
+    if (d >= 0) {
+        ::fsync(d);
+        ::close(d);
+    }
+}
+
+/** Writes images to one path on a thread of its own, so the engine only
+ *  pays for building the image. A newer image replaces one still waiting
+ *  to be written; the last one submitted is always written before the
+ *  writer goes away. */
+class writer
+{
+public:
+    explicit writer ( std::string path )
+        : path(std::move(path)), waiting(false), error(0), written(0), stopping(false),
+          thread(&writer::serve, this) {}
+
+    writer ( writer const& ) = delete;
+    writer& operator= ( writer const& ) = delete;
+
+    ~writer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        thread.join();
+    }
+
+    void submit ( image img )
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            next = std::move(img);
+            waiting = true;
+        }
+        wake.notify_one();
+    }
+
+    /** Checkpoints written so far, and the errno of the last failure. */
+    auto count() const -> long
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return written;
+    }
+    auto failure() const -> int
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return error;
+    }
+
+private:
+    void serve()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this]{ return waiting || stopping; });
+            if (!waiting) { return; }
+            auto img = std::move(next);
+            waiting = false;
+            lock.unlock();
+            auto e = 0;
+            try { write(path, img); } catch (std::system_error const& x) { e = x.code().value(); }
+            lock.lock();
+            if (e) { error = e; } else { ++written; }
+        }
+    }
+
+    std::string const path;
+    image next;
+    bool waiting;
+    int error;
+    long written;
+    bool stopping;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::thread thread;
+};
+
+}
+
+#endif
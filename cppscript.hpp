@@ -1,47 +1,245 @@
 #ifndef HPP_CPPSCRIPT
 #define HPP_CPPSCRIPT
 
-#include <thread>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <iostream>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 namespace cppscript
 {
 
+/** Hashed timing wheel driven by one service thread.
+ *
+ *  Timers hash into `slots` buckets by due tick; a bucket is a list, and
+ *  an index maps every timer to its node, so scheduling and cancelling
+ *  are O(1) however many timers there are. The thread sleeps until the
+ *  next non-empty bucket comes round and runs due callbacks itself, one at
+ *  a time with the lock released, so callbacks should be short: set a
+ *  flag, request a stop, print a line.
+ *
+ *  cancel() is synchronous: once it returns the callback is not running
+ *  and never will again. Called from inside the callback it only stops
+ *  further runs.
+ */
+class timer_wheel
+{
+public:
+    using clock = std::chrono::steady_clock;
+    using callback = std::function<void()>;
+    using id = std::uint64_t;
+
+    explicit timer_wheel ( std::chrono::milliseconds tick = std::chrono::milliseconds(1),
+                           std::size_t slots = 512 )
+        : resolution(tick.count() > 0 ? tick : std::chrono::milliseconds(1)),
+          wheel(slots ? slots : 1), start(clock::now()), current(0), next_id(1),
+          running(0), stopping(false)
+    { service = std::thread(&timer_wheel::serve, this); }
+
+    timer_wheel ( timer_wheel const& ) = delete;
+    timer_wheel& operator= ( timer_wheel const& ) = delete;
+
+    ~timer_wheel()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        service.join();
+    }
+
+    /** The process-wide wheel, started on first use and never destroyed,
+     *  so handles can still be cleared from static destructors. */
+    static auto instance() -> timer_wheel&
+    {
+        static auto wheel = new timer_wheel();
+        return *wheel;
+    }
+
+    /** Run f once after `delay`, then every `period` if that is non-zero. */
+    auto schedule ( callback f, std::chrono::milliseconds delay,
+                    std::chrono::milliseconds period = std::chrono::milliseconds(0) ) -> id
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto key = next_id++;
+        auto t = timer { key, std::move(f), ticks(period), 0 };
+        insert(std::move(t), now() + std::max<std::uint64_t>(1, ticks(delay)));
+        lock.unlock();
+        wake.notify_one();
+        return key;
+    }
+
+    /** Stop timer `key`; true if it was still live. */
+    bool cancel ( id key )
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto i = index.find(key);
+        if (i == index.end()) { return false; }
+        auto slot = i->second.first;
+        if (slot < wheel.size()) { wheel[slot].erase(i->second.second); }
+        index.erase(i);
+        if (running == key && std::this_thread::get_id() != service.get_id())
+            { finished.wait(lock, [&]{ return running != key; }); }
+        return true;
+    }
+
+    /** Timers waiting to fire. */
+    auto size() const -> std::size_t
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return index.size();
+    }
+
+private:
+    struct timer
+    {
+        id key;
+        callback f;
+        std::uint64_t period;   // in ticks; 0 fires once
+        std::uint64_t due;      // absolute tick
+    };
+    using bucket = std::list<timer>;
+
+    auto ticks ( std::chrono::milliseconds d ) const -> std::uint64_t
+        { return d.count() <= 0 ? 0 : std::uint64_t((d + resolution - std::chrono::milliseconds(1)) / resolution); }
+    auto now() const -> std::uint64_t { return std::uint64_t((clock::now() - start) / resolution); }
+
+    /* with the lock held */
+    void insert ( timer t, std::uint64_t due )
+    {
+        t.due = due;
+        auto slot = std::size_t(due % wheel.size());
+        auto key = t.key;
+        wheel[slot].push_back(std::move(t));
+        index[key] = std::make_pair(slot, std::prev(wheel[slot].end()));
+    }
+
+    void serve ()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        bucket due;
+        while (!stopping) {
+            // collect everything due up to now, bucket by bucket
+            for ( auto target = now(); current <= target; ++current ) {
+                auto& b = wheel[current % wheel.size()];
+                for ( auto t = b.begin(); t != b.end(); ) {
+                    auto n = std::next(t);
+                    if (t->due <= current) {
+                        index[t->key].first = wheel.size();   // in flight
+                        due.splice(due.end(), b, t);
+                    }
+                    t = n;
+                }
+            }
+
+            while (!due.empty()) {
+                auto key = due.front().key;
+                if (!index.count(key)) {
+                    due.pop_front();
+                    continue;
+                }
+                running = key;
+                auto f = due.front().f;
+                lock.unlock();
+                f();
+                lock.lock();
+                running = 0;
+                finished.notify_all();
+
+                auto i = index.find(key);
+                if (i != index.end() && due.front().period > 0) {
+                    auto t = std::move(due.front());
+                    due.pop_front();
+                    index.erase(i);
+                    auto at = std::max(current, t.due + t.period);
+                    insert(std::move(t), at);
+                } else {
+                    if (i != index.end()) { index.erase(i); }
+                    due.pop_front();
+                }
+            }
+
+            if (index.empty()) {
+                wake.wait(lock);
+                current = std::max(current, now());
+                continue;
+            }
+            // sleep until the next bucket with anything in it comes round
+            auto ahead = std::size_t(0);
+            while (ahead < wheel.size() && wheel[(current + ahead) % wheel.size()].empty()) { ++ahead; }
+            wake.wait_until(lock, start + resolution * (current + ahead));
+        }
+    }
+
+    std::chrono::milliseconds const resolution;
+    std::vector<bucket> wheel;
+    std::unordered_map<id,std::pair<std::size_t,bucket::iterator>> index;
+    clock::time_point const start;
+    std::uint64_t current;
+    id next_id;
+    id running;
+    bool stopping;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    std::thread service;
+};
+
+    /** Handle to a timer on the process-wide wheel. The timer lives as
+     *  long as its handle: dropping or overwriting the handle cancels it,
+     *  as clear_timeout/clear_interval do. */
     class _base_timer
     {
     protected:
-        _base_timer() : state(new bool(true)) {}
-        _base_timer(_base_timer && to)
-            : mine(std::move(to.mine)), state(to.state) { to.state = nullptr; }
-        _base_timer& operator= (_base_timer && to)
-            {
-                std::cerr << "check1a " << to.mine.get_id() << "\n";
-                mine.swap(to.mine);
-                std::cerr << "check1b " << mine.get_id() << "\n";
-                state = to.state;
-                std::cerr << "check1c\n";
-                to.state = nullptr;
-                std::cerr << "check1d\n";
-                return *this;
+        _base_timer() : key(0) {}
+        explicit _base_timer ( timer_wheel::id key ) : key(key) {}
+        _base_timer ( _base_timer && to ) : key(to.key) { to.key = 0; }
+        ~_base_timer() { cancel(); }
+        _base_timer& operator= ( _base_timer && to )
+        {
+            if (this != &to) {
+                cancel();
+                key = to.key;
+                to.key = 0;
             }
-        ~_base_timer() { if (state) delete state; }
-        bool active() const { return *state; }
-        void cancel() { *state = false; }
-        void watch(std::thread && t)
-            { mine = std::move(t); }
-        std::thread mine;
-        bool* state;
+            return *this;
+        }
+        bool active() const { return key != 0; }
+        void cancel() { if (key) { timer_wheel::instance().cancel(key); key = 0; } }
+        timer_wheel::id key;
     };
 
     class timeout : protected _base_timer
     {
+    public:
+        timeout() = default;
+        timeout ( timeout&& ) = default;
+        timeout& operator= ( timeout&& ) = default;
+    private:
+        explicit timeout ( timer_wheel::id key ) : _base_timer(key) {}
         template <typename F>
-        friend timeout set_timeout ( F, int );
+        friend timeout set_timeout ( F, std::chrono::milliseconds );
         friend void clear_timeout ( timeout& );
     };
 
     class interval : protected _base_timer
     {
+    public:
+        interval() = default;
+        interval ( interval&& ) = default;
+        interval& operator= ( interval&& ) = default;
+    private:
+        explicit interval ( timer_wheel::id key ) : _base_timer(key) {}
         template <typename F>
         friend interval set_interval ( F, int );
         friend void clear_interval ( interval& );
@@ -49,34 +247,49 @@ namespace cppscript
 
 
 template <typename F>
-timeout set_timeout ( F func, int millis )
+timeout set_timeout ( F func, std::chrono::milliseconds delay )
 {
-    timeout t;
-    bool* active = t.state;
-    t.watch( std::thread([func,millis,active](){
-        std::this_thread::sleep_for( std::chrono::milliseconds(millis) );
-        if (*active) { func(); }
-    }) );
-    return std::move(t);
+    return timeout(timer_wheel::instance().schedule(func, delay));
 }
 
+template <typename F>
+timeout set_timeout ( F func, int millis )
+    { return set_timeout(func, std::chrono::milliseconds(millis)); }
+
 template <typename F>
 interval set_interval ( F func, int millis )
 {
-    interval t;
-    bool* active = t.state;
-    t.watch( std::thread([func,millis,active](){
-        std::this_thread::sleep_for( std::chrono::milliseconds(millis) );
-        while (*active) {
-            func();
-            std::this_thread::sleep_for( std::chrono::milliseconds(millis) );
-        }
-    }) );
-    return std::move(t);
+    auto period = std::chrono::milliseconds(std::max(1, millis));
+    return interval(timer_wheel::instance().schedule(func, period, period));
 }
 
-void clear_interval ( interval& t ) { t.cancel(); }
-void clear_timeout ( timeout& t ) { t.cancel(); }
+/* Once these return, the callback is not running and will not run again. */
+inline void clear_interval ( interval& t ) { t.cancel(); }
+inline void clear_timeout ( timeout& t ) { t.cancel(); }
+
+/** Flag raised by an interval and consumed by a worker at a point of its
+ *  own choosing: the wheel thread only flips a bit, and whatever the flag
+ *  stands for (a snapshot, a checkpoint) runs on the worker's thread. */
+class trigger
+{
+public:
+    explicit trigger ( int millis )
+        : raised(false), timer(set_interval([this]{ raised.store(true, std::memory_order_relaxed); }, millis)) {}
+    trigger ( trigger const& ) = delete;
+    trigger& operator= ( trigger const& ) = delete;
+    ~trigger() { clear_interval(timer); }
+
+    /** True once per interval that has elapsed since the last true. */
+    bool consume()
+    {
+        return raised.load(std::memory_order_relaxed)
+            && raised.exchange(false, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<bool> raised;
+    interval timer;
+};
 
 }
 
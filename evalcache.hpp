@@ -0,0 +1,302 @@
+#ifndef HPP_EVALCACHE
+#define HPP_EVALCACHE
+
+#include "objective.hpp"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cache_format
+{
+    char const MAGIC[8] = { 'P', 'S', 'O', 'C', 'A', 'C', 'H', 'E' };
+}
+
+/** Objective with a persistent memo of its results in front of it.
+ *
+ *  Results live in a file mapped into every process that opens it, made
+ *  for one objective (by name and accuracy), one d and one tolerance: an
+ *  open-addressing hash table keyed on positions quantized to multiples
+ *  of `tolerance` (0 keys on the exact bits). A position probes at most
+ *  PROBE slots from its hash; a miss evaluates the wrapped objective and
+ *  stores the result in the first free slot of those, or else over the
+ *  least recently used one. Slots are never emptied, so a probe can stop
+ *  at the first free slot.
+ *
+ *  Every slot is a sequence lock over relaxed atomics, as in shared_best,
+ *  so threads and processes share the table without a lock: a reader
+ *  that catches a slot mid-write treats it as a miss, and a writer skips
+ *  a slot someone else is writing. A process that dies mid-write leaves
+ *  one slot unusable, nothing worse. Hit, miss, insert and eviction
+ *  counts are kept in the file, over every process that used it.
+ */
+class cached_objective : public objective
+{
+public:
+    struct statistics
+    {
+        long long hits;
+        long long misses;
+        long long inserts;
+        long long evictions;
+    };
+
+    /** Wrap f (and own it), known as `name`, with the cache in `path`,
+     *  created if need be with room for `capacity` positions (rounded up
+     *  to a power of two). An existing file must have been made for the
+     *  same name (its first NAME - 1 characters), accuracy, d and
+     *  tolerance. */
+    cached_objective ( objective* f, std::string const& name, std::string const& path, std::size_t d,
+                       double tolerance = 1e-9, std::size_t capacity = 1 << 16 )
+        : f(f), d(d), q(tolerance), slots(1), stride(SLOT_WORDS + d), base(nullptr), length(0)
+    {
+        char id[NAME] = {};
+        name.copy(id, NAME - 1);
+        while (slots < capacity) { slots <<= 1; }
+        length = HEADER + slots * stride * sizeof(std::uint64_t);
+
+        auto created = true;
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0 && errno == EEXIST) {
+            created = false;
+            fd = ::open(path.c_str(), O_RDWR);
+        }
+        if (fd < 0) { throw std::system_error(errno, std::generic_category(), path); }
+        if (created && ::ftruncate(fd, off_t(length)) != 0) {
+            auto e = errno;
+            ::close(fd);
+            ::unlink(path.c_str());
+            throw std::system_error(e, std::generic_category(), path);
+        }
+        if (!created) { length = wait_for_header(fd, path); }
+        auto p = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) { throw std::system_error(errno, std::generic_category(), path); }
+        base = static_cast<char*>(p);
+
+        auto h = head();
+        if (created) {
+            // the zero-filled file is already an empty table
+            h->d = d;
+            h->slots = slots;
+            h->tolerance = q;
+            std::memcpy(h->name, id, NAME);
+            h->accuracy = std::uint64_t(f->accuracy());
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memcpy(h->magic, cache_format::MAGIC, sizeof(cache_format::MAGIC));
+        } else if (h->d != d || h->tolerance != q || std::memcmp(h->name, id, NAME) != 0
+                   || h->accuracy != std::uint64_t(f->accuracy())
+                   || length != HEADER + h->slots * (SLOT_WORDS + d) * sizeof(std::uint64_t)) {
+            ::munmap(base, length);
+            throw std::system_error(EINVAL, std::generic_category(), path + ": cache made for another problem");
+        } else {
+            slots = h->slots;
+        }
+    }
+
+    cached_objective ( cached_objective const& ) = delete;
+    cached_objective& operator= ( cached_objective const& ) = delete;
+
+    ~cached_objective() { ::munmap(base, length); }
+
+    auto operator() ( param a, param b ) const -> double
+    {
+        // one key buffer per thread, grown once
+        thread_local std::vector<std::int64_t> key;
+        key.resize(d);
+        auto h = quantize(a, key.data());
+        double cost;
+        if (find(h, key.data(), cost)) { return cost; }
+        cost = (*f)(a, b);
+        insert(h, key.data(), cost);
+        return cost;
+    }
+
+    /** Rows that miss go to the wrapped objective as one batch. */
+    void evaluate ( double const* x, std::size_t n, std::size_t d,
+                    std::size_t pitch, double* cost ) const
+    {
+        std::vector<std::int64_t> keys(n * d);
+        std::vector<std::uint64_t> hashes(n);
+        std::vector<std::size_t> missed;
+        for ( std::size_t i = 0; i < n; ++i ) {
+            hashes[i] = quantize(x + i * pitch, &keys[i * d]);
+            if (!find(hashes[i], &keys[i * d], cost[i])) { missed.push_back(i); }
+        }
+        if (missed.empty()) { return; }
+
+        std::vector<double> rows(missed.size() * d), costs(missed.size());
+        for ( std::size_t m = 0; m < missed.size(); ++m )
+            { std::copy(x + missed[m] * pitch, x + missed[m] * pitch + d, &rows[m * d]); }
+        f->evaluate(rows.data(), missed.size(), d, d, costs.data());
+        for ( std::size_t m = 0; m < missed.size(); ++m ) {
+            auto i = missed[m];
+            cost[i] = costs[m];
+            insert(hashes[i], &keys[i * d], costs[m]);
+        }
+    }
+
+    auto domain ( unsigned i ) const -> domain_type { return f->domain(i); }
+    auto extremum ( unsigned i ) const -> double { return f->extremum(i); }
+    auto accuracy() const -> simd::accuracy { return f->accuracy(); }
+
+    auto stats() const -> statistics
+    {
+        auto h = head();
+        return statistics { h->hits.load(std::memory_order_relaxed),
+                            h->misses.load(std::memory_order_relaxed),
+                            h->inserts.load(std::memory_order_relaxed),
+                            h->evictions.load(std::memory_order_relaxed) };
+    }
+
+    auto capacity() const -> std::size_t { return slots; }
+
+private:
+    static std::size_t const HEADER = 128;
+    /* slot: sequence, hash (0 = free), last use, cost, then d key words */
+    static std::size_t const SLOT_WORDS = 4;
+    static std::size_t const PROBE = 8;
+    static std::size_t const NAME = 32;
+
+    struct header
+    {
+        char magic[8];
+        std::uint64_t d;
+        std::uint64_t slots;
+        double tolerance;
+        char name[NAME];
+        std::atomic<long long> hits;
+        std::atomic<long long> misses;
+        std::atomic<long long> inserts;
+        std::atomic<long long> evictions;
+        std::atomic<std::uint64_t> clock;
+        // zero (precise) in files from before it was recorded
+        std::uint64_t accuracy;
+    };
+
+    auto head() const -> header* { return reinterpret_cast<header*>(base); }
+    auto slot ( std::size_t i ) const -> std::atomic<std::uint64_t>*
+        { return reinterpret_cast<std::atomic<std::uint64_t>*>(base + HEADER) + i * stride; }
+
+    /* a file another process is creating: wait (briefly) for its header */
+    auto wait_for_header ( int fd, std::string const& path ) const -> std::size_t
+    {
+        for ( auto tries = 0; tries < 1000; ++tries ) {
+            struct stat st;
+            char magic[sizeof(cache_format::MAGIC)];
+            if (::fstat(fd, &st) == 0 && std::size_t(st.st_size) >= HEADER
+                    && ::pread(fd, magic, sizeof(magic), 0) == ssize_t(sizeof(magic))
+                    && std::memcmp(magic, cache_format::MAGIC, sizeof(cache_format::MAGIC)) == 0)
+                { return std::size_t(st.st_size); }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ::close(fd);
+        throw std::system_error(EINVAL, std::generic_category(), path + ": not a cache");
+    }
+
+    /* key words of x and their hash, never 0 */
+    auto quantize ( double const* x, std::int64_t* key ) const -> std::uint64_t
+    {
+        auto h = std::uint64_t(14695981039346656037ULL);
+        for ( std::size_t j = 0; j < d; ++j ) {
+            if (q > 0) {
+                key[j] = std::int64_t(std::llround(x[j] / q));
+            } else {
+                auto v = x[j] == 0.0 ? 0.0 : x[j];   // -0 and 0 are one key
+                std::memcpy(&key[j], &v, sizeof(v));
+            }
+            h = (h ^ std::uint64_t(key[j])) * 1099511628211ULL;
+            h ^= h >> 29;
+        }
+        return h | 1;
+    }
+
+    bool find ( std::uint64_t h, std::int64_t const* key, double& cost ) const
+    {
+        auto stamp = head()->clock.load(std::memory_order_relaxed);
+        for ( std::size_t p = 0; p < PROBE; ++p ) {
+            auto s = slot((h + p) & (slots - 1));
+            auto s0 = s[0].load(std::memory_order_acquire);
+            auto sh = s[1].load(std::memory_order_relaxed);
+            if (sh == 0 && !(s0 & 1)) { break; }
+            if (sh != h || (s0 & 1)) { continue; }
+            auto c = s[3].load(std::memory_order_relaxed);
+            auto same = true;
+            for ( std::size_t j = 0; j < d && same; ++j )
+                { same = s[SLOT_WORDS + j].load(std::memory_order_relaxed) == std::uint64_t(key[j]); }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (!same || s[0].load(std::memory_order_relaxed) != s0) { continue; }
+            s[2].store(stamp, std::memory_order_relaxed);
+            std::memcpy(&cost, &c, sizeof(cost));
+            head()->hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        head()->misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    void insert ( std::uint64_t h, std::int64_t const* key, double cost ) const
+    {
+        // a free slot, else the least recently used of the window
+        auto victim = slots;
+        auto oldest = ~std::uint64_t(0);
+        for ( std::size_t p = 0; p < PROBE; ++p ) {
+            auto i = (h + p) & (slots - 1);
+            auto s = slot(i);
+            if (s[0].load(std::memory_order_relaxed) & 1) { continue; }
+            auto sh = s[1].load(std::memory_order_relaxed);
+            if (sh == 0) {
+                victim = i;
+                oldest = 0;
+                break;
+            }
+            auto used = s[2].load(std::memory_order_relaxed);
+            if (used < oldest) {
+                oldest = used;
+                victim = i;
+            }
+        }
+        if (victim == slots) { return; }
+
+        auto s = slot(victim);
+        auto s0 = s[0].load(std::memory_order_relaxed);
+        if ((s0 & 1) || !s[0].compare_exchange_strong(s0, s0 + 1, std::memory_order_acquire,
+                                                      std::memory_order_relaxed)) { return; }
+        auto evicted = s[1].load(std::memory_order_relaxed) != 0;
+        std::atomic_thread_fence(std::memory_order_release);
+        std::uint64_t c;
+        std::memcpy(&c, &cost, sizeof(c));
+        s[1].store(h, std::memory_order_relaxed);
+        s[2].store(head()->clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        s[3].store(c, std::memory_order_relaxed);
+        for ( std::size_t j = 0; j < d; ++j )
+            { s[SLOT_WORDS + j].store(std::uint64_t(key[j]), std::memory_order_relaxed); }
+        s[0].store(s0 + 2, std::memory_order_release);
+
+        head()->inserts.fetch_add(1, std::memory_order_relaxed);
+        if (evicted) { head()->evictions.fetch_add(1, std::memory_order_relaxed); }
+    }
+
+    std::unique_ptr<objective> f;
+    std::size_t const d;
+    double const q;
+    std::size_t slots;
+    std::size_t const stride;
+    char* base;
+    std::size_t length;
+};
+
+#endif
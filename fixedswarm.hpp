@@ -0,0 +1,195 @@
+#ifndef HPP_FIXEDSWARM
+#define HPP_FIXEDSWARM
+
+#include "objective.hpp"
+#include "params.hpp"
+#include "philox.hpp"
+#include "stop.hpp"
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace fixed
+{
+
+/** Call f(0), f(1), ..., f(D-1) with the loop spelled out at compile time. */
+template <typename F, std::size_t... J>
+inline void unroll ( F&& f, std::index_sequence<J...> )
+{
+    int expand[] = { 0, (f(J), 0)... };
+    (void) expand;
+}
+
+template <std::size_t D, typename F>
+inline void unroll ( F&& f ) { unroll(std::forward<F>(f), std::make_index_sequence<D>()); }
+
+/** Swarm engine for a dimension known at compile time.
+ *
+ *  Same algorithm as the dynamic swarm in pso.cpp, but each particle is a
+ *  handful of std::arrays in one contiguous vector, every per-dimension
+ *  loop is unrolled, and the objective is called through its static type
+ *  so small fixed-size functions (beale, booth, colville, ...) inline
+ *  into the update.
+ */
+template <std::size_t D, typename T = double, typename F = objective>
+class swarm
+{
+    static_assert(D > 0, "a swarm needs at least one dimension");
+    static_assert(std::is_floating_point<T>::value, "positions must be floating point");
+    static_assert(std::is_base_of<objective,F>::value, "F must be an objective");
+
+public:
+    using vector_type = std::array<T,D>;
+    using solution = std::pair<double,std::vector<double>>;
+    using param_type = pso_param;
+
+    explicit swarm ( F* f = new F(),
+                     param_type p = {20,2.0,2.0,1.0,1.0,0.95,0.5,0.95,200},
+                     std::uint64_t seed = std::random_device()() )
+        : param(p), f(f), particles(std::size_t(p.n)), leader(0), sweep(0),
+          poll(stop_token(), CHECK), rng(seed)
+    {
+        unroll<D>([this](std::size_t j){
+            auto bounds = this->f->domain(j);
+            vmax[j] = T((bounds.second - bounds.first) * param.k);
+        });
+    }
+
+    solution best_solution() const
+    {
+        auto const& g = particles[leader];
+        return solution(g.best_cost, std::vector<double>(g.best.begin(), g.best.end()));
+    }
+
+    /** Stop once t expires as well as on the target and the budget; the
+     *  token is looked at every CHECK updates. */
+    void stop_on ( stop_token t ) { poll = stop_poll(std::move(t), CHECK); }
+    auto stop() const -> stop_token const& { return poll.token(); }
+
+    void operator() ()
+    {
+        initialize();
+
+        auto k = 0LL, t = 0LL;
+        do {
+            ++sweep;
+            for ( auto i = 0UL; i < particles.size(); ++i, ++k ) {
+                if ( update(i) ) {
+                    t = 0;
+                } else {
+                    ++t;
+                }
+                if (t == param.d) {
+                    t = 0;
+                    param.w  *= param.wd;
+                    unroll<D>([this](std::size_t j){ vmax[j] *= T(param.vd); });
+                }
+
+                if (particles[leader].best_cost < 0.1 || k > 640000 || poll()) {
+                    std::cerr << k << std::endl;
+                    return;
+                }
+            }
+        } while (true);
+    }
+
+private:
+    /* updates between looks at the stop token */
+    static unsigned const CHECK = 64;
+
+    struct particle
+    {
+        vector_type position;
+        vector_type velocity;
+        vector_type best;
+        double best_cost = std::numeric_limits<double>::infinity();
+    };
+
+    auto cost ( vector_type const& x ) const -> double
+    {
+        std::array<double,D> y;
+        unroll<D>([&](std::size_t j){ y[j] = double(x[j]); });
+        return call(y.data(), std::is_abstract<F>());
+    }
+
+    auto call ( double const* x, std::true_type ) const -> double
+        { return (*f)(x, x + D); }
+    // qualified call: no virtual dispatch once F is a concrete objective
+    auto call ( double const* x, std::false_type ) const -> double
+        { return f->F::operator()(x, x + D); }
+
+    bool update ( std::size_t i )
+    {
+        auto& pi = particles[i];
+        auto const& g = particles[leader].best;
+        std::array<double,D> r1, r2;
+        rng.fill(i, sweep, philox::COGNITIVE, r1.data(), D);
+        rng.fill(i, sweep, philox::SOCIAL, r2.data(), D);
+
+        // compute velocity and update position
+        unroll<D>([&](std::size_t j){
+            auto x = pi.position[j];
+            auto v = pi.velocity[j] * T(param.w)
+                + T(r1[j] * param.c1) * (pi.best[j] - x)
+                + T(r2[j] * param.c2) * (g[j] - x);
+            v = std::max( std::min( v, vmax[j] ), -vmax[j] );
+            pi.velocity[j] = v;
+            pi.position[j] = x + v;
+        });
+
+        // compute cost
+        auto c = cost(pi.position);
+        // update personal best
+        if ( c < pi.best_cost ) {
+            pi.best = pi.position;
+            pi.best_cost = c;
+            // update global best
+            if ( c < particles[leader].best_cost ) {
+                leader = i;
+            }
+            if (leader == i) { return true; }
+        }
+        return false;
+    }
+
+    void initialize()
+    {
+        for ( auto i = 0UL; i < particles.size(); ++i ) {
+            auto& pi = particles[i];
+            std::array<double,D> u;
+            rng.fill(i, 0, philox::POSITION, u.data(), D);
+            unroll<D>([&](std::size_t j){
+                auto bounds = f->domain(j);
+                pi.position[j] = T(bounds.first + u[j] * (bounds.second - bounds.first));
+            });
+            rng.fill(i, 0, philox::VELOCITY, u.data(), D);
+            unroll<D>([&](std::size_t j){
+                pi.velocity[j] = -vmax[j] + T(u[j]) * (vmax[j] + vmax[j]);
+            });
+            pi.best = pi.position;
+            pi.best_cost = cost(pi.position);
+            if (pi.best_cost < particles[leader].best_cost || i == 0) {
+                leader = i;
+            }
+        }
+    }
+
+    param_type param;
+    std::unique_ptr<F> f;
+    std::vector<particle> particles;
+    vector_type vmax;
+    std::size_t leader;
+    long long sweep;
+    stop_poll poll;
+    philox rng;
+};
+
+}
+
+#endif
@@ -0,0 +1,92 @@
+#include "islands.hpp"
+#include "shmislands.hpp"
+#include "cppscript.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+
+template <typename Engine>
+int report ( Engine& a )
+{
+    auto best = a.best_solution();
+    std::cout << best.first << std::endl;
+    std::copy(best.second.cbegin(), best.second.cend(), std::ostream_iterator<double>(std::cout," "));
+    std::cout << std::endl;
+    return 0;
+}
+
+/* "evaluations best" on stderr every `millis` ms while a runs */
+template <typename Engine>
+auto progress ( Engine const& a, int millis ) -> cppscript::interval
+{
+    if (millis <= 0) { return cppscript::interval(); }
+    return cppscript::set_interval([&a]{
+        std::cerr << a.evaluations() << ' ' << a.best_cost() << std::endl;
+    }, millis);
+}
+
+int main (int argc, char** argv)
+{
+    // islands [-p] [-t seconds] [-r millis] [function [dimensions [islands [interval [ring|random|full [worst|random|worse]]]]]]
+    // -p runs each island in its own process, -t stops the run after the given time,
+    // -r prints progress every so many milliseconds
+    bool processes = false, bad = false;
+    double seconds = 0.0;
+    int millis = 0;
+    while (argc > 1 && argv[1][0] == '-') {
+        if (std::string(argv[1]) == "-p") { processes = true; }
+        else if (std::string(argv[1]) == "-t" && argc > 2) { seconds = atof(argv[2]); --argc; ++argv; }
+        else if (std::string(argv[1]) == "-r" && argc > 2) { millis = atoi(argv[2]); --argc; ++argv; }
+        else { bad = true; break; }
+        --argc;
+        ++argv;
+    }
+    std::string const name = argc > 1 ? argv[1] : "rastrigin";
+    int const d = argc > 2 ? atoi(argv[2]) : 64;
+    unsigned const k = argc > 3 ? atoi(argv[3]) : std::max(2U, std::thread::hardware_concurrency());
+    std::string const to = argc > 5 ? argv[5] : "ring";
+    std::string const policy = argc > 6 ? argv[6] : "worse";
+
+    migration_param m { argc > 4 ? atol(argv[4]) : 20, 2,
+                        migration_param::topology::ring,
+                        migration_param::replacement::worse };
+    if (to == "random") { m.to = migration_param::topology::random; }
+    if (to == "full") { m.to = migration_param::topology::full; }
+    if (policy == "worst") { m.policy = migration_param::replacement::worst; }
+    if (policy == "random") { m.policy = migration_param::replacement::random; }
+
+    if (bad || !std::unique_ptr<objective>(make_objective(name)) || d < 1) {
+        std::cerr << "usage: " << argv[0]
+                  << " [-p] [-t seconds] [-r millis] [function [dimensions [islands [interval [ring|random|full [worst|random|worse]]]]]]"
+                  << std::endl;
+        return 1;
+    }
+
+    auto make = [&](unsigned) { return new swarm(d, make_objective(name)); };
+
+    if (processes) {
+        process_archipelago a { k, std::size_t(d), make, m };
+        if (seconds > 0) { a.stop().time_limit(seconds); }
+        auto ticker = progress(a, millis);
+        a();
+        cppscript::clear_interval(ticker);
+        std::cerr << a.evaluations() << std::endl;
+        for ( auto i = 0UL; i < a.size(); ++i )
+            { std::cerr << i << ": " << a.island_cost(i) << std::endl; }
+        if (a.failures()) { std::cerr << a.failures() << " island(s) failed" << std::endl; }
+        return report(a);
+    }
+
+    archipelago a { k, make, m };
+    if (seconds > 0) { a.stop().time_limit(seconds); }
+    auto ticker = progress(a, millis);
+    a();
+    cppscript::clear_interval(ticker);
+    std::cerr << a.evaluations() << std::endl;
+    for ( auto i = 0UL; i < a.size(); ++i )
+        { std::cerr << i << ": " << a.island(i).best_solution().first << std::endl; }
+    return report(a);
+}
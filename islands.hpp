@@ -0,0 +1,203 @@
+#ifndef HPP_ISLANDS
+#define HPP_ISLANDS
+
+#include "channel.hpp"
+#include "philox.hpp"
+#include "pso.hpp"
+#include "stop.hpp"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+/** How and when islands exchange particles. */
+struct migration_param
+{
+    enum class topology { ring, random, full };
+    enum class replacement { worst, random, worse };
+
+    /* Sweeps between migrations */
+    long interval;
+    /* Best particles sent per migration */
+    unsigned migrants;
+    /* ring: to the next island; random: to one other island; full: to all */
+    topology to;
+    /* worst: overwrite the worst particle; random: a random one;
+     * worse: the worst one, but only if the migrant beats it */
+    replacement policy;
+
+    /** Call send(j) for every island j that island id of k migrates to;
+     *  u is a uniform draw for the random topology. */
+    template <typename Send>
+    void route ( std::size_t id, std::size_t k, double u, Send send ) const
+    {
+        if (k < 2) { return; }
+        switch (to) {
+        case topology::ring:
+            send((id + 1) % k);
+            break;
+        case topology::random:
+            send((id + 1 + std::size_t(u * (k - 1))) % k);
+            break;
+        case topology::full:
+            for ( std::size_t j = 0; j < k; ++j ) { if (j != id) { send(j); } }
+            break;
+        }
+    }
+
+    /** Particle of s a migrant of the given cost replaces, or s.size() to
+     *  turn it away; u is a uniform draw for the random policy. */
+    auto victim ( swarm const& s, double cost, double u ) const -> std::size_t
+    {
+        auto worst = std::size_t(0);
+        for ( std::size_t i = 1; i < s.size(); ++i )
+            { if (s.cost(i) > s.cost(worst)) { worst = i; } }
+
+        switch (policy) {
+        case replacement::worst:
+            return worst;
+        case replacement::random:
+            return std::size_t(u * s.size());
+        case replacement::worse:
+            return cost < s.cost(worst) ? worst : s.size();
+        }
+        return s.size();
+    }
+};
+
+/** What an island last reported: its evaluations and its best cost. One
+ *  line per island, written by the island after every sweep and safe to
+ *  read from any thread (or process, in shared memory) during the run. */
+struct island_status
+{
+    island_status() : evaluations(0), best(std::numeric_limits<double>::infinity()) {}
+    std::atomic<long long> evaluations;
+    std::atomic<double> best;
+    char padding[64 - sizeof(std::atomic<long long>) - sizeof(std::atomic<double>)];
+};
+
+/** Island-model engine: K independent swarms, one thread each.
+ *
+ *  Islands never wait for each other. Every `interval` sweeps an island
+ *  pushes copies of its best personal bests into the inboxes of its
+ *  destinations and, after every sweep, folds in whatever has arrived in
+ *  its own. Inboxes are bounded lock-free channels; a full inbox drops
+ *  the migrant rather than stall the sender. The run ends for everyone
+ *  as soon as one island reaches the target or its evaluation budget, or
+ *  the shared stop token expires; every island checks it every few
+ *  updates, so a deadline or stop request ends the run promptly.
+ */
+class archipelago
+{
+public:
+    using solution = swarm::solution;
+    using factory = std::function<swarm* ( unsigned island )>;
+
+    archipelago ( unsigned k, factory make, migration_param m,
+                  std::uint64_t seed = std::random_device()() )
+        : param(m), status(std::max(1U, k)), rng(seed)
+    {
+        k = std::max(1U, k);
+        for ( auto i = 0U; i < k; ++i ) {
+            islands.emplace_back(make(i));
+            islands.back()->stop_on(token);
+            inbox.emplace_back(new channel<solution>(2 * k * std::max(1U, m.migrants)));
+        }
+    }
+
+    void operator() ()
+    {
+        std::vector<std::thread> pool;
+        for ( auto i = 0U; i < islands.size(); ++i )
+            { pool.emplace_back(&archipelago::run, this, i); }
+        for ( auto& t : pool ) { t.join(); }
+    }
+
+    /** Shared by all islands: set a deadline or budget, or request a stop. */
+    auto stop() const -> stop_token const& { return token; }
+
+    auto size() const -> std::size_t { return islands.size(); }
+    auto island ( std::size_t i ) const -> swarm const& { return *islands[i]; }
+
+    solution best_solution() const
+    {
+        auto best = islands[0]->best_solution();
+        for ( auto const& s : islands ) {
+            auto b = s->best_solution();
+            if (b.first < best.first) { best = std::move(b); }
+        }
+        return best;
+    }
+
+    /** Evaluations and best cost so far; both may be read while the
+     *  islands run, e.g. from a progress interval. */
+    auto evaluations() const -> long long
+    {
+        auto k = 0LL;
+        for ( auto const& s : status ) { k += s.evaluations.load(std::memory_order_relaxed); }
+        return k;
+    }
+    auto best_cost() const -> double
+    {
+        auto c = std::numeric_limits<double>::infinity();
+        for ( auto const& s : status ) { c = std::min(c, s.best.load(std::memory_order_relaxed)); }
+        return c;
+    }
+
+private:
+    void run ( unsigned id )
+    {
+        auto& s = *islands[id];
+        s.initialize();
+        publish(id);
+        for ( auto sweep = 1L; !token.stop_requested(); ++sweep ) {
+            auto going = s.step();
+            publish(id);
+            if (!going) {
+                token.request_stop();
+                break;
+            }
+            if (param.interval > 0 && sweep % param.interval == 0) { emigrate(id, sweep); }
+            absorb(id, sweep);
+        }
+    }
+
+    void publish ( unsigned id )
+    {
+        auto const& s = *islands[id];
+        status[id].evaluations.store(s.evaluations(), std::memory_order_relaxed);
+        status[id].best.store(s.cost(s.leading()), std::memory_order_relaxed);
+    }
+
+    void emigrate ( unsigned id, long sweep )
+    {
+        auto out = islands[id]->emigrants(param.migrants);
+        param.route(id, islands.size(), rng(id, sweep, philox::MIGRATION, 0),
+            [&](std::size_t j) {
+                for ( auto const& m : out ) { inbox[j]->try_push(m); }
+            });
+    }
+
+    void absorb ( unsigned id, long sweep )
+    {
+        auto& s = *islands[id];
+        solution m;
+        for ( auto draw = 1UL; inbox[id]->try_pop(m); ++draw ) {
+            auto i = param.victim(s, m.first, rng(id, sweep, philox::MIGRATION, draw));
+            if (i < s.size()) { s.immigrate(i, m.first, m.second.data()); }
+        }
+    }
+
+    migration_param param;
+    std::vector<std::unique_ptr<swarm>> islands;
+    std::vector<std::unique_ptr<channel<solution>>> inbox;
+    aligned_vector<island_status> status;
+    stop_token token;
+    philox rng;
+};
+
+#endif
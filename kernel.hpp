@@ -0,0 +1,165 @@
+#ifndef HPP_KERNEL
+#define HPP_KERNEL
+
+#include <algorithm>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNEL_X86 1
+#endif
+
+/* Every variant must round exactly like the scalar reference, so keep the
+ * compiler from contracting the multiply/add pairs into FMAs. */
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+namespace kernel
+{
+
+/** Fused PSO step over one particle:
+ *      v = clamp(w v + r1 c1 (p - x) + r2 c2 (g - x), -vmax, vmax)
+ *      x = x + v
+ *  r1 and r2 hold one uniform per dimension. */
+using update_fn = void (*)( double* x, double* v,
+                            double const* p, double const* g,
+                            double const* vmax,
+                            double const* r1, double const* r2,
+                            double w, double c1, double c2,
+                            std::size_t n );
+
+inline void update_scalar ( double* x, double* v,
+                            double const* p, double const* g,
+                            double const* vmax,
+                            double const* r1, double const* r2,
+                            double w, double c1, double c2,
+                            std::size_t n )
+{
+    for ( std::size_t j = 0; j < n; ++j ) {
+        auto xj = x[j];
+        auto vj = v[j] * w
+            + r1[j] * c1 * (p[j] - xj)
+            + r2[j] * c2 * (g[j] - xj);
+        vj = std::max( std::min( vj, vmax[j] ), -vmax[j] );
+        v[j] = vj;
+        x[j] = xj + vj;
+    }
+}
+
+#ifdef KERNEL_X86
+
+/* min/max operand order mirrors std::min(v,vmax)/std::max(v,-vmax) so that
+ * NaNs and signed zeros come out the same as in update_scalar. */
+
+__attribute__((target("sse2")))
+inline void update_sse2 ( double* x, double* v,
+                          double const* p, double const* g,
+                          double const* vmax,
+                          double const* r1, double const* r2,
+                          double w, double c1, double c2,
+                          std::size_t n )
+{
+    auto const W = _mm_set1_pd(w), C1 = _mm_set1_pd(c1), C2 = _mm_set1_pd(c2);
+    auto const NEG = _mm_set1_pd(-0.0);
+    std::size_t j = 0;
+    for ( ; j + 2 <= n; j += 2 ) {
+        auto xj = _mm_loadu_pd(x + j);
+        auto vj = _mm_mul_pd(_mm_loadu_pd(v + j), W);
+        vj = _mm_add_pd(vj, _mm_mul_pd(_mm_mul_pd(_mm_loadu_pd(r1 + j), C1),
+                                       _mm_sub_pd(_mm_loadu_pd(p + j), xj)));
+        vj = _mm_add_pd(vj, _mm_mul_pd(_mm_mul_pd(_mm_loadu_pd(r2 + j), C2),
+                                       _mm_sub_pd(_mm_loadu_pd(g + j), xj)));
+        auto vm = _mm_loadu_pd(vmax + j);
+        vj = _mm_max_pd(_mm_xor_pd(vm, NEG), _mm_min_pd(vm, vj));
+        _mm_storeu_pd(v + j, vj);
+        _mm_storeu_pd(x + j, _mm_add_pd(xj, vj));
+    }
+    update_scalar(x + j, v + j, p + j, g + j, vmax + j, r1 + j, r2 + j,
+                  w, c1, c2, n - j);
+}
+
+__attribute__((target("avx2")))
+inline void update_avx2 ( double* x, double* v,
+                          double const* p, double const* g,
+                          double const* vmax,
+                          double const* r1, double const* r2,
+                          double w, double c1, double c2,
+                          std::size_t n )
+{
+    auto const W = _mm256_set1_pd(w), C1 = _mm256_set1_pd(c1), C2 = _mm256_set1_pd(c2);
+    auto const NEG = _mm256_set1_pd(-0.0);
+    std::size_t j = 0;
+    for ( ; j + 4 <= n; j += 4 ) {
+        auto xj = _mm256_loadu_pd(x + j);
+        auto vj = _mm256_mul_pd(_mm256_loadu_pd(v + j), W);
+        vj = _mm256_add_pd(vj, _mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(r1 + j), C1),
+                                             _mm256_sub_pd(_mm256_loadu_pd(p + j), xj)));
+        vj = _mm256_add_pd(vj, _mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(r2 + j), C2),
+                                             _mm256_sub_pd(_mm256_loadu_pd(g + j), xj)));
+        auto vm = _mm256_loadu_pd(vmax + j);
+        vj = _mm256_max_pd(_mm256_xor_pd(vm, NEG), _mm256_min_pd(vm, vj));
+        _mm256_storeu_pd(v + j, vj);
+        _mm256_storeu_pd(x + j, _mm256_add_pd(xj, vj));
+    }
+    update_sse2(x + j, v + j, p + j, g + j, vmax + j, r1 + j, r2 + j,
+                w, c1, c2, n - j);
+}
+
+__attribute__((target("avx512f")))
+inline void update_avx512 ( double* x, double* v,
+                            double const* p, double const* g,
+                            double const* vmax,
+                            double const* r1, double const* r2,
+                            double w, double c1, double c2,
+                            std::size_t n )
+{
+    auto const W = _mm512_set1_pd(w), C1 = _mm512_set1_pd(c1), C2 = _mm512_set1_pd(c2);
+    auto const NEG = _mm512_set1_epi64(0x8000000000000000LL);
+    for ( std::size_t j = 0; j < n; j += 8 ) {
+        __mmask8 m = n - j >= 8 ? 0xFF : (1u << (n - j)) - 1;
+        auto xj = _mm512_maskz_loadu_pd(m, x + j);
+        auto vj = _mm512_mul_pd(_mm512_maskz_loadu_pd(m, v + j), W);
+        vj = _mm512_add_pd(vj, _mm512_mul_pd(_mm512_mul_pd(_mm512_maskz_loadu_pd(m, r1 + j), C1),
+                                             _mm512_sub_pd(_mm512_maskz_loadu_pd(m, p + j), xj)));
+        vj = _mm512_add_pd(vj, _mm512_mul_pd(_mm512_mul_pd(_mm512_maskz_loadu_pd(m, r2 + j), C2),
+                                             _mm512_sub_pd(_mm512_maskz_loadu_pd(m, g + j), xj)));
+        auto vm = _mm512_maskz_loadu_pd(m, vmax + j);
+        auto nvm = _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(vm), NEG));
+        vj = _mm512_maskz_max_pd(m, nvm, _mm512_maskz_min_pd(m, vm, vj));
+        _mm512_mask_storeu_pd(v + j, m, vj);
+        _mm512_mask_storeu_pd(x + j, m, _mm512_add_pd(xj, vj));
+    }
+}
+
+#endif // KERNEL_X86
+
+/** Pick the widest variant the running CPU supports. */
+inline auto select() -> update_fn
+{
+#ifdef KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) { return update_avx512; }
+    if (__builtin_cpu_supports("avx2")) { return update_avx2; }
+    if (__builtin_cpu_supports("sse2")) { return update_sse2; }
+#endif
+    return update_scalar;
+}
+
+/** The update kernel chosen once at startup. */
+inline auto update() -> update_fn
+{
+    static update_fn const fn = select();
+    return fn;
+}
+
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+#endif
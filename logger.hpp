@@ -0,0 +1,221 @@
+#ifndef HPP_LOGGER
+#define HPP_LOGGER
+
+#include "channel.hpp"
+#include "population.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/** Asynchronous log for diagnostics from hot loops.
+ *
+ *  A worker's write() copies a fixed-size binary record (a tag, a
+ *  timestamp and up to VALUES numbers) into a ring of its own: no lock,
+ *  no allocation, no formatting and no I/O on the worker. A background
+ *  thread drains the rings every `period`, orders the batch by time,
+ *  formats it and hands it to the stream in one write. At most
+ *  `per_second` records are written each second; the rest are counted and
+ *  reported as suppressed, and so are records dropped by a full ring.
+ *
+ *  Each thread takes a ring of every logger it writes to the first time
+ *  it does; threads beyond `slots` lose their records (counted as
+ *  dropped). Tags must outlive the logger (string literals).
+ */
+class logger
+{
+public:
+    using clock = std::chrono::steady_clock;
+    static std::size_t const VALUES = 6;
+
+    explicit logger ( std::ostream& out = std::cerr, std::size_t slots = 64,
+                      std::size_t capacity = 1 << 12, long per_second = 10000,
+                      std::chrono::milliseconds period = std::chrono::milliseconds(10) )
+        : out(out), rings(slots ? slots : 1), per_second(per_second), period(period),
+          start(clock::now()), serial(generation()++), claimed(0), unowned(0),
+          window(0), written(0), suppressed(0), reported(0), stopping(false)
+    {
+        for ( auto& r : rings ) { r.reserve(capacity); }
+        writer = std::thread(&logger::serve, this);
+    }
+
+    logger ( logger const& ) = delete;
+    logger& operator= ( logger const& ) = delete;
+
+    /** Writes out whatever is still queued. */
+    ~logger()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        writer.join();
+        drain(true);
+    }
+
+    /** The process-wide log on std::cerr, flushed at exit. */
+    static auto standard() -> logger&
+    {
+        static logger log;
+        return log;
+    }
+
+    /** Queue `tag` followed by the values; never blocks. */
+    template <typename... Values>
+    void write ( char const* tag, Values... values )
+    {
+        static_assert(sizeof...(Values) <= VALUES, "too many values for one record");
+        auto r = ring_of_caller();
+        if (!r) {
+            unowned.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        auto e = r->claim();
+        if (!e) { return; }
+        e->tag = tag;
+        e->ns = std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+        e->source = std::uint32_t(r - &rings[0]);
+        double v[] = { double(values)..., 0.0 };
+        e->count = std::uint32_t(sizeof...(Values));
+        std::copy(v, v + sizeof...(Values), e->value);
+        r->publish();
+    }
+
+    /** Records lost to full rings or to threads without a ring. */
+    auto dropped() const -> long long
+    {
+        auto n = unowned.load(std::memory_order_relaxed);
+        for ( auto const& r : rings ) { n += r.dropped(); }
+        return n;
+    }
+
+private:
+    struct record
+    {
+        char const* tag;
+        std::uint64_t ns;
+        std::uint32_t source;
+        std::uint32_t count;
+        double value[VALUES];
+    };
+
+    /* written by the owning thread, drained by the writer */
+    using ring = spsc_ring<record>;
+
+    /* tells loggers apart in the per-thread cache, even at a reused address */
+    static auto generation() -> std::atomic<std::uint64_t>&
+    {
+        static std::atomic<std::uint64_t> g(1);
+        return g;
+    }
+
+    /* the calling thread's ring in this logger, taken on its first write
+     * here; the thread's rings are kept by logger, the last used first */
+    auto ring_of_caller() -> ring*
+    {
+        thread_local std::vector<std::pair<std::uint64_t,ring*>> mine;
+        if (!mine.empty() && mine.front().first == serial) { return mine.front().second; }
+        auto i = std::find_if(mine.begin(), mine.end(),
+            [this](std::pair<std::uint64_t,ring*> const& m) { return m.first == serial; });
+        if (i == mine.end()) {
+            auto k = claimed.fetch_add(1, std::memory_order_relaxed);
+            mine.emplace_back(serial, k < rings.size() ? &rings[k] : nullptr);
+            i = mine.end() - 1;
+        }
+        std::iter_swap(mine.begin(), i);
+        return mine.front().second;
+    }
+
+    /* on the writer thread, or after it has stopped; losses are reported
+     * once a second and at the end */
+    void drain ( bool last = false )
+    {
+        batch.clear();
+        auto lost = 0LL;
+        for ( auto& r : rings ) {
+            r.drain([this](record const& e) { batch.push_back(e); });
+            lost += r.dropped();
+        }
+        lost += unowned.load(std::memory_order_relaxed);
+        std::stable_sort(batch.begin(), batch.end(),
+            [](record const& a, record const& b) { return a.ns < b.ns; });
+
+        text.str("");
+        for ( auto const& e : batch ) {
+            // a new one-second window every second
+            if (e.ns / 1000000000 != window) {
+                losses(lost);
+                window = e.ns / 1000000000;
+                written = 0;
+            }
+            if (per_second > 0 && written >= per_second) {
+                ++suppressed;
+                continue;
+            }
+            ++written;
+            text << std::fixed << std::setprecision(6) << e.ns * 1e-9 << " [" << e.source << "] " << e.tag;
+            text.unsetf(std::ios::floatfield);
+            text << std::setprecision(6);
+            for ( auto i = 0U; i < e.count; ++i ) { text << ' ' << e.value[i]; }
+            text << '\n';
+        }
+        if (last) { losses(lost); }
+        auto s = text.str();
+        if (!s.empty()) { out.write(s.data(), std::streamsize(s.size())).flush(); }
+    }
+
+    void losses ( long long lost )
+    {
+        if (suppressed) {
+            text << suppressed << " log records suppressed\n";
+            suppressed = 0;
+        }
+        if (lost > reported) {
+            text << lost - reported << " log records dropped\n";
+            reported = lost;
+        }
+    }
+
+    void serve()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            wake.wait_for(lock, period);
+            lock.unlock();
+            drain();
+            lock.lock();
+        }
+    }
+
+    std::ostream& out;
+    aligned_vector<ring> rings;
+    long const per_second;
+    std::chrono::milliseconds const period;
+    clock::time_point const start;
+    std::uint64_t const serial;
+    std::atomic<std::size_t> claimed;
+    std::atomic<long long> unowned;
+    // writer thread only
+    std::vector<record> batch;
+    std::ostringstream text;
+    std::uint64_t window;
+    long written;
+    long long suppressed;
+    long long reported;
+    bool stopping;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread writer;
+};
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef HPP_NET
+#define HPP_NET
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/** Thin blocking TCP helpers. Setup failures throw std::system_error; a
+ *  peer that goes away mid-stream is not exceptional and shows up as a
+ *  false return from send_all/recv_all instead. */
+namespace net
+{
+
+/** Owning file descriptor. */
+class socket
+{
+public:
+    socket() : fd(-1) {}
+    explicit socket ( int fd ) : fd(fd) {}
+    socket ( socket&& s ) : fd(s.fd) { s.fd = -1; }
+    socket& operator= ( socket&& s ) { close(); fd = s.fd; s.fd = -1; return *this; }
+    socket ( socket const& ) = delete;
+    socket& operator= ( socket const& ) = delete;
+    ~socket() { close(); }
+
+    auto get() const -> int { return fd; }
+    explicit operator bool() const { return fd >= 0; }
+    void close() { if (fd >= 0) { ::close(fd); fd = -1; } }
+
+private:
+    int fd;
+};
+
+inline void no_delay ( int fd )
+{
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+}
+
+/** Probe an idle connection so a peer that vanished without a FIN or RST
+ *  (power loss, a partition) fails the next read within about half a
+ *  minute instead of never. */
+inline void keep_alive ( int fd )
+{
+    int one = 1, idle = 10, interval = 5, count = 3;
+    ::setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof one);
+    ::setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof idle);
+    ::setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof interval);
+    ::setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof count);
+}
+
+/** Make send_all give up once a send has been stuck for `limit`, as it is
+ *  when the peer is alive but has stopped reading. */
+inline void send_timeout ( int fd, std::chrono::milliseconds limit )
+{
+    timeval tv {};
+    tv.tv_sec = time_t(limit.count() / 1000);
+    tv.tv_usec = suseconds_t(limit.count() % 1000 * 1000);
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+}
+
+/** Listen on port (0 picks a free one) on all interfaces. */
+inline auto listen ( std::uint16_t port, int backlog = 64 ) -> socket
+{
+    socket s(::socket(AF_INET, SOCK_STREAM, 0));
+    if (!s) { throw std::system_error(errno, std::generic_category(), "socket"); }
+    int one = 1;
+    ::setsockopt(s.get(), SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (::bind(s.get(), reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0)
+        { throw std::system_error(errno, std::generic_category(), "bind"); }
+    if (::listen(s.get(), backlog) != 0)
+        { throw std::system_error(errno, std::generic_category(), "listen"); }
+    return s;
+}
+
+/** Port a listening socket ended up on. */
+inline auto port ( socket const& s ) -> std::uint16_t
+{
+    sockaddr_in addr {};
+    socklen_t len = sizeof addr;
+    ::getsockname(s.get(), reinterpret_cast<sockaddr*>(&addr), &len);
+    return ntohs(addr.sin_port);
+}
+
+inline auto accept ( socket const& l ) -> socket
+{
+    int fd;
+    while ((fd = ::accept(l.get(), nullptr, nullptr)) < 0 && errno == EINTR) {}
+    if (fd < 0) { throw std::system_error(errno, std::generic_category(), "accept"); }
+    no_delay(fd);
+    keep_alive(fd);
+    return socket(fd);
+}
+
+inline auto connect ( std::string const& host, std::uint16_t port ) -> socket
+{
+    addrinfo hints {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    if (::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res) != 0 || !res)
+        { throw std::system_error(EHOSTUNREACH, std::generic_category(), "getaddrinfo " + host); }
+    socket s(::socket(res->ai_family, res->ai_socktype, res->ai_protocol));
+    auto rc = s ? ::connect(s.get(), res->ai_addr, res->ai_addrlen) : -1;
+    auto e = errno;
+    ::freeaddrinfo(res);
+    if (rc != 0) { throw std::system_error(e, std::generic_category(), "connect"); }
+    no_delay(s.get());
+    keep_alive(s.get());
+    return s;
+}
+
+inline bool send_all ( int fd, void const* data, std::size_t n )
+{
+    auto p = static_cast<char const*>(data);
+    while (n > 0) {
+        auto k = ::send(fd, p, n, MSG_NOSIGNAL);
+        if (k < 0 && errno == EINTR) { continue; }
+        if (k <= 0) { return false; }
+        p += k;
+        n -= std::size_t(k);
+    }
+    return true;
+}
+
+inline bool recv_all ( int fd, void* data, std::size_t n )
+{
+    auto p = static_cast<char*>(data);
+    while (n > 0) {
+        auto k = ::recv(fd, p, n, 0);
+        if (k < 0 && errno == EINTR) { continue; }
+        if (k <= 0) { return false; }
+        p += k;
+        n -= std::size_t(k);
+    }
+    return true;
+}
+
+}
+
+#endif
@@ -1,134 +1,408 @@
 #ifndef HPP_OBJECTIVE
 #define HPP_OBJECTIVE
 
+#include "simdmath.hpp"
 #include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <numeric>
 #include <stdexcept>
+#include <string>
 #include <utility>
+#include <vector>
 
-//    using typename objective<FwdIter>::domain_type;
-//    using param_type = std::vector<double>::const_iterator;
-
-class objective
+struct objective
 {
-public:
+    using param = double const*;
     using domain_type = std::pair<double,double>;
-    using param_type = std::vector<double>::const_iterator;
-    using result_type = double;
 
-    virtual auto
-    operator() ( param_type a, param_type b ) const -> result_type = 0;
+    /** Number of rows a batched evaluation advances in lock step. */
+    static std::size_t const LANES = 8;
+    /** Values per stack buffer handed to the simd math layer. */
+    static std::size_t const CHUNK = 64;
+
+    virtual ~objective() = default;
+
+    virtual auto operator() ( param a, param b ) const -> double = 0;
+    virtual auto domain ( unsigned i ) const -> domain_type = 0;
+    virtual auto extremum ( unsigned i ) const -> double = 0;
+    /** The math behind the costs: fast and precise costs of one position
+     *  differ in the last digits. */
+    virtual auto accuracy() const -> simd::accuracy { return simd::accuracy::precise; }
+
+    /** The cost of [a,b) if it is below `bound`; otherwise any value not
+     *  below it. Objectives that are sums of non-negative terms override
+     *  this to give up once a partial sum passes the bound, checking once
+     *  per CHUNK values; a cost they do finish is bit for bit the one
+     *  operator() returns. */
+    virtual auto bounded ( param a, param b, double /*bound*/ ) const -> double
+        { return (*this)(a, b); }
+
+    /** Evaluate n rows of d values each, row i starting at x + i * pitch,
+     *  into cost[0..n). Overrides must accumulate each row in the same
+     *  order as operator() so both paths agree on every particle. */
+    virtual void evaluate ( double const* x, std::size_t n, std::size_t d,
+                            std::size_t pitch, double* cost ) const
+    {
+        for ( std::size_t i = 0; i < n; ++i, x += pitch )
+            { cost[i] = (*this)(x, x + d); }
+    }
 
-    virtual auto domain() const -> domain_type = 0;
+protected:
+    static auto unbounded() -> double { return std::numeric_limits<double>::infinity(); }
+
+    /** Whether a lower bound on the cost rules out `bound`. The margin is
+     *  far above the rounding a bound and the finished sum can differ by;
+     *  `slack` adds what the rest of the sum may take off (fast math). */
+    static bool beyond ( double low, double bound, double slack = 0.0 )
+        { return low > bound + slack + 1e-9 * (1.0 + std::abs(bound)); }
+
+    /** Hand a batch to `block` LANES rows at a time. Each call receives the
+     *  first row, the pitch, the number of live rows m <= LANES and the
+     *  matching slice of cost; the per-row accumulators then sit side by
+     *  side so the compiler can vectorize across particles. */
+    template <typename Block>
+    static void by_lanes ( double const* x, std::size_t n, std::size_t pitch,
+                           double* cost, Block block )
+    {
+        for ( std::size_t i = 0; i < n; i += LANES )
+            { block(x + i * pitch, pitch, n - i < LANES ? n - i : LANES, cost + i); }
+    }
 };
 
 class sphere : public objective
 {
 public:
-    auto operator() ( param_type a, param_type b ) const -> result_type
+    auto operator() ( param a, param b ) const -> double { return sum(a, b, unbounded()); }
+    auto bounded ( param a, param b, double bound ) const -> double { return sum(a, b, bound); }
+    void evaluate ( double const* x, std::size_t n, std::size_t d,
+                    std::size_t pitch, double* cost ) const
     {
-        auto cost = std::inner_product(a, b, a, 0.0);
+        by_lanes(x, n, pitch, cost,
+            [d](double const* x, std::size_t pitch, std::size_t m, double* cost) {
+                double acc[LANES] = {};
+                for ( std::size_t j = 0; j < d; ++j ) {
+                    for ( std::size_t k = 0; k < m; ++k ) {
+                        auto xj = x[k * pitch + j];
+                        acc[k] = acc[k] + xj * xj;
+                    }
+                }
+                std::copy(acc, acc + m, cost);
+            }
+        );
+    }
+    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-5.12, 5.12); }
+    auto extremum ( unsigned i ) const -> double { return 0.0; }
+private:
+    static auto sum ( param a, param b, double bound ) -> double
+    {
+        std::size_t const n = b - a;
+        auto cost = 0.0;
+        for ( std::size_t j0 = 0; j0 < n; j0 += CHUNK ) {
+            std::size_t m = n - j0 < CHUNK ? n - j0 : CHUNK;
+            for ( std::size_t j = j0; j < j0 + m; ++j )
+                { cost = cost + a[j] * a[j]; }
+            if (beyond(cost, bound)) { break; }
+        }
         return cost;
     }
-
-    auto domain() const -> domain_type { return std::make_pair(-5.12, 5.12); }
 };
 
 class rosenbrock : public objective
 {
 public:
-    auto operator() ( param_type a, param_type b ) const -> result_type
-    {
-        std::vector<double> tmp;
-        std::adjacent_difference(a, b, std::back_inserter(tmp),
-            [](double x2, double x1) {
-                double t1 = x2 - x1 * x1;
-                double t2 = 1 - x1;
-                return 100.0 * t1 * t1 + t2 * t2;
+    auto operator() ( param a, param b ) const -> double { return sum(a, b, unbounded()); }
+    auto bounded ( param a, param b, double bound ) const -> double { return sum(a, b, bound); }
+    void evaluate ( double const* x, std::size_t n, std::size_t d,
+                    std::size_t pitch, double* cost ) const
+    {
+        by_lanes(x, n, pitch, cost,
+            [d](double const* x, std::size_t pitch, std::size_t m, double* cost) {
+                double acc[LANES] = {};
+                for ( std::size_t j = 1; j < d; ++j ) {
+                    for ( std::size_t k = 0; k < m; ++k ) {
+                        auto x1 = x[k * pitch + j - 1];
+                        auto x2 = x[k * pitch + j];
+                        auto t1 = x1 * x1  - x2;
+                        auto t2 = x1 - 1.0;
+                        acc[k] = acc[k] + (100.0 * t1 * t1 + t2 * t2);
+                    }
+                }
+                std::copy(acc, acc + m, cost);
             }
         );
-        double cost = std::accumulate(tmp.begin()+1, tmp.end(), 0.0);
+    }
+    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-5.0, 10.0); }
+    auto extremum ( unsigned i ) const -> double { return (i == 0 ? 0.0 : 1.0); }
+    auto tolerance () const -> double { return 0.01; }
+private:
+    static auto sum ( param a, param b, double bound ) -> double
+    {
+        std::size_t const n = b - a;
+        auto cost = 0.0;
+        for ( std::size_t j0 = 1; j0 < n; j0 += CHUNK ) {
+            std::size_t m = n - j0 < CHUNK ? n - j0 : CHUNK;
+            for ( std::size_t j = j0; j < j0 + m; ++j ) {
+                auto t1 = a[j-1] * a[j-1]  - a[j];
+                auto t2 = a[j-1] - 1.0;
+                cost = cost + (100.0 * t1 * t1 + t2 * t2);
+            }
+            if (beyond(cost, bound)) { break; }
+        }
         return cost;
     }
-
-    auto domain() const -> domain_type { return std::make_pair(-5.0, 10.0); }
 };
 
 class rastrigin : public objective
 {
 public:
-    auto operator() ( param_type a, param_type b ) const -> result_type
+    explicit rastrigin ( simd::accuracy mode = simd::accuracy::precise )
+        : mode(mode) {}
+
+    auto operator() ( param a, param b ) const -> double { return sum(a, b, unbounded()); }
+    auto bounded ( param a, param b, double bound ) const -> double { return sum(a, b, bound); }
+    void evaluate ( double const* x, std::size_t n, std::size_t d,
+                    std::size_t pitch, double* cost ) const
     {
-        double cost = std::accumulate(a, b, 0.0,
-            [](double sum, double x) {
-                static double const TWOPI = 8 * std::atan(1.0);
-                return sum + x * x - 10 * std::cos(TWOPI * x);
+        by_lanes(x, n, pitch, cost,
+            [d,this](double const* x, std::size_t pitch, std::size_t m, double* cost) {
+                static auto const TWOPI = 8.0 * std::atan(1.0);
+                double acc[LANES] = {};
+                double c[LANES][CHUNK];
+                for ( std::size_t j0 = 0; j0 < d; j0 += CHUNK ) {
+                    std::size_t len = d - j0 < CHUNK ? d - j0 : CHUNK;
+                    for ( std::size_t k = 0; k < m; ++k ) {
+                        auto xk = x + k * pitch + j0;
+                        std::transform(xk, xk + len, c[k], [](double x) { return TWOPI * x; });
+                        simd::cos(c[k], c[k], len, mode);
+                    }
+                    for ( std::size_t j = 0; j < len; ++j ) {
+                        for ( std::size_t k = 0; k < m; ++k ) {
+                            auto xj = x[k * pitch + j0 + j];
+                            acc[k] = acc[k] + xj * xj - 10.0 * c[k][j];
+                        }
+                    }
+                }
+                for ( std::size_t k = 0; k < m; ++k )
+                    { cost[k] = 10.0 * unsigned(d) + acc[k]; }
             }
-        );            
-        unsigned n = distance(a,b);
-        return 10 * n + cost;
+        );
+    }
+    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-5.12, 5.12); }
+    auto extremum ( unsigned i ) const -> double { return 0.0; }
+    auto accuracy() const -> simd::accuracy { return mode; }
+private:
+    /* every term x^2 - 10 cos(2 pi x) + 10 is non-negative, so the terms
+     * summed so far plus 10 for each bound the cost from below; with the
+     * fast cos a term still to come may be as low as -10 FAST_COS_ERROR */
+    auto sum ( param a, param b, double bound ) const -> double
+    {
+        static auto const TWOPI = 8.0 * std::atan(1.0);
+        unsigned n = std::distance(a,b);
+        double c[CHUNK];
+        auto cost = 0.0;
+        for ( std::size_t j0 = 0; j0 < n; j0 += CHUNK ) {
+            std::size_t m = n - j0 < CHUNK ? n - j0 : CHUNK;
+            auto p = a + j0;
+            std::transform(p, p + m, c, [](double x) { return TWOPI * x; });
+            simd::cos(c, c, m, mode);
+            for ( std::size_t j = 0; j < m; ++j )
+                { cost = cost + p[j] * p[j] - 10.0 * c[j]; }
+            auto low = 10.0 * unsigned(j0 + m) + cost;
+            auto slack = mode == simd::accuracy::fast ? 10.0 * simd::FAST_COS_ERROR * (n - j0 - m) : 0.0;
+            if (beyond(low, bound, slack)) { return low; }
+        }
+        return 10.0 * n + cost;
     }
-    auto domain() const -> domain_type { return std::make_pair(-5.12, 5.12); }
+
+    simd::accuracy mode;
 };
 
 class griewangk : public objective
 {
 public:
-    auto operator() ( param_type a, param_type b ) const -> result_type
+    explicit griewangk ( simd::accuracy mode = simd::accuracy::precise )
+        : mode(mode) {}
+
+    auto operator() ( param a, param b ) const -> double { return sum(a, b, unbounded()); }
+    auto bounded ( param a, param b, double bound ) const -> double { return sum(a, b, bound); }
+    void evaluate ( double const* x, std::size_t n, std::size_t d,
+                    std::size_t pitch, double* cost ) const
     {
-        double cost1 = std::accumulate(a, b, 0.0,
-            [](double sum, double x) { return sum + x * x  / 4000.0; }
+        // the column scales are shared by every row of the batch
+        std::vector<double> scale(d);
+        auto i = 0.0;
+        std::generate(scale.begin(), scale.end(), [&i](){ return ++i; });
+        simd::sqrt(scale.data(), scale.data(), d);
+
+        by_lanes(x, n, pitch, cost,
+            [d,&scale,this](double const* x, std::size_t pitch, std::size_t m, double* cost) {
+                double sum[LANES] = {};
+                double prod[LANES];
+                double q[LANES][CHUNK];
+                std::fill(prod, prod + LANES, 1.0);
+                for ( std::size_t j0 = 0; j0 < d; j0 += CHUNK ) {
+                    std::size_t len = d - j0 < CHUNK ? d - j0 : CHUNK;
+                    for ( std::size_t k = 0; k < m; ++k ) {
+                        auto xk = x + k * pitch + j0;
+                        std::transform(xk, xk + len, &scale[j0], q[k], std::divides<double>());
+                        simd::cos(q[k], q[k], len, mode);
+                    }
+                    for ( std::size_t j = 0; j < len; ++j ) {
+                        for ( std::size_t k = 0; k < m; ++k ) {
+                            auto xj = x[k * pitch + j0 + j];
+                            sum[k] = sum[k] + xj * xj  / 4000.0;
+                            prod[k] = prod[k] * q[k][j];
+                        }
+                    }
+                }
+                for ( std::size_t k = 0; k < m; ++k )
+                    { cost[k] = sum[k] - prod[k] + 1.0; }
+            }
         );
-        unsigned i = 0;
-        double cost2 = std::accumulate(a, b, 1.0,
-            [&i](double prod, double x) {
-                return prod * std::cos(x / std::sqrt(++i));
+    }
+    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-600.0, 600.0); }
+    auto extremum ( unsigned i ) const -> double { return 0.0; }
+    auto accuracy() const -> simd::accuracy { return mode; }
+private:
+    /* the product is at most 1, so the sum term alone bounds the cost;
+     * with the fast cos a factor may exceed 1 by FAST_COS_ERROR */
+    auto sum ( param a, param b, double bound ) const -> double
+    {
+        std::size_t const n = b - a;
+        auto const slack = mode == simd::accuracy::fast
+            ? std::pow(1.0 + simd::FAST_COS_ERROR, double(n)) - 1.0 : 0.0;
+        auto cost1 = 0.0, cost2 = 1.0;
+        double q[CHUNK];
+        auto i = 0.0;
+        for ( std::size_t j0 = 0; j0 < n; j0 += CHUNK ) {
+            std::size_t m = n - j0 < CHUNK ? n - j0 : CHUNK;
+            auto p = a + j0;
+            std::generate(q, q + m, [&i](){ return ++i; });
+            simd::sqrt(q, q, m);
+            std::transform(p, p + m, q, q, std::divides<double>());
+            simd::cos(q, q, m, mode);
+            for ( std::size_t j = 0; j < m; ++j ) {
+                cost1 = cost1 + p[j] * p[j]  / 4000.0;
+                cost2 = cost2 * q[j];
+            }
+            if (beyond(cost1, bound, slack)) { return cost1; }
+        }
+        return cost1 - cost2 + 1.0;
+    }
+
+    simd::accuracy mode;
+};
+
+class ackley : public objective
+{
+public:
+    explicit ackley ( simd::accuracy mode = simd::accuracy::precise )
+        : mode(mode) {}
+
+    auto operator() ( param a, param b ) const -> double
+    {
+        static auto const TWOPI = 8.0 * std::atan(1.0);
+        auto n = std::distance(a, b);
+        auto s1 = 0.0, s2 = 0.0;
+        double c[CHUNK];
+        for ( std::ptrdiff_t j0 = 0; j0 < n; j0 += CHUNK ) {
+            std::size_t m = n - j0 < std::ptrdiff_t(CHUNK) ? n - j0 : CHUNK;
+            auto p = a + j0;
+            std::transform(p, p + m, c, [](double x) { return TWOPI * x; });
+            simd::cos(c, c, m, mode);
+            for ( std::size_t j = 0; j < m; ++j ) {
+                s1 = s1 + p[j] * p[j];
+                s2 = s2 + c[j];
+            }
+        }
+        return finish(n, s1, s2);
+    }
+    void evaluate ( double const* x, std::size_t n, std::size_t d,
+                    std::size_t pitch, double* cost ) const
+    {
+        by_lanes(x, n, pitch, cost,
+            [d,this](double const* x, std::size_t pitch, std::size_t m, double* cost) {
+                static auto const TWOPI = 8.0 * std::atan(1.0);
+                double s1[LANES] = {};
+                double s2[LANES] = {};
+                double c[LANES][CHUNK];
+                for ( std::size_t j0 = 0; j0 < d; j0 += CHUNK ) {
+                    std::size_t len = d - j0 < CHUNK ? d - j0 : CHUNK;
+                    for ( std::size_t k = 0; k < m; ++k ) {
+                        auto xk = x + k * pitch + j0;
+                        std::transform(xk, xk + len, c[k], [](double x) { return TWOPI * x; });
+                        simd::cos(c[k], c[k], len, mode);
+                    }
+                    for ( std::size_t j = 0; j < len; ++j ) {
+                        for ( std::size_t k = 0; k < m; ++k ) {
+                            auto xj = x[k * pitch + j0 + j];
+                            s1[k] = s1[k] + xj * xj;
+                            s2[k] = s2[k] + c[k][j];
+                        }
+                    }
+                }
+                for ( std::size_t k = 0; k < m; ++k )
+                    { cost[k] = finish(d, s1[k], s2[k]); }
             }
         );
-        return cost1 - cost2 + 1;
     }
-    auto domain() const -> domain_type { return std::make_pair(-600.0, 600.0); }
+    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-15.0, 30.0); }
+    auto extremum ( unsigned i ) const -> double { return 0.0; }
+    auto accuracy() const -> simd::accuracy { return mode; }
+private:
+    auto finish ( std::ptrdiff_t n, double s1, double s2 ) const -> double
+    {
+        return mode == simd::accuracy::fast
+            ? 20.0 + std::exp(1.0)
+              - 20.0 * simd::exp<simd::accuracy::fast>(-0.2 * simd::sqrt(1.0 / n * s1))
+              - simd::exp<simd::accuracy::fast>(1.0 / n * s2)
+            : 20.0 + std::exp(1.0)
+              - 20.0 * simd::exp(-0.2 * simd::sqrt(1.0 / n * s1))
+              - simd::exp(1.0 / n * s2);
+    }
+    simd::accuracy mode;
 };
 
 class shaffer_f6 : public objective
 {
 public:
-    auto operator() ( param_type a, param_type b ) const -> result_type
+    auto operator() ( param a, param b ) const -> double
     {
-        auto x = *(a++), y = *a;
-        auto h = x * x + y * y;
+        auto x1 = *(a++), x2 = *a;
+        auto h = x1 * x1 + x2 * x2;
         auto denom = 1 + 0.001 * h;
-        auto numer = std::sin(std::sqrt(h));  
-        double cost = 0.5 + (numer * numer - 0.5) / (denom * denom);
+        auto numer = std::sin(std::sqrt(h));
+        auto cost = 0.5 + (numer * numer - 0.5) / (denom * denom);
         return cost;
     }
-    //auto domain() const -> domain_type { return std::make_pair(-600.0, 600.0); }
+    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); } //!!
+    auto extremum ( unsigned i ) const -> double { return 0.0; }
 };
 
-class ackley : public objective
+class shaffer_f6_inv : public objective
 {
 public:
-    auto operator() ( param_type a, param_type b ) const -> result_type
+    auto operator() ( param a, param b ) const -> double
     {
-        auto n = std::distance(a, b);
-        constexpr auto TWOPI = 8.0 * std::atan(1.0);
-        double s1 = std::accumulate(a, b, 0.0,
-            [](double sum, double x) { return sum + x * x; }
-        );
-        double s2 = std::accumulate(a, b, 0.0,
-            [](double sum, double x) { return sum + std::cos(TWOPI * x); }
-        );
-        double cost = 20.0 + std::exp(1.0)
-                       - 20.0 * std::exp(-0.2 * std::sqrt(1.0 / n * s1))
-                       - std::exp(1.0 / n * s2);
+        auto x1 = *(a++), x2 = *a;
+        auto h = x1 * x1 + x2 * x2;
+        auto denom = 1 + 0.001 * h;
+        auto numer = std::sin(std::sqrt(h));
+        auto cost = 0.5 - (numer * numer - 0.5) / (denom * denom);
         return cost;
     }
-    auto domain() const -> domain_type { return std::make_pair(-15.0, 30.0); }
+    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); } //!!
+    auto extremum ( unsigned i ) const -> double { return 0.0; }
 };
 
 class beale : public objective
 {
 public:
-    auto operator() ( param_type a, param_type b ) const -> result_type
+    auto operator() ( param a, param b ) const -> double
     {
         if (std::distance(a, b) != 2)
             { throw std::logic_error("must have exactly 2 dimensions"); }
@@ -140,7 +414,157 @@ public:
         double cost = t1 * t1 + t2 * t2 + t3 * t3;
         return cost;
     }
-    auto domain() const -> domain_type { return std::make_pair(-4.5, 4.5); }
+    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-4.5, 4.5); }
+    auto extremum ( unsigned i ) const -> double
+        { return (i == 0 ? 0.0 : (i == 1 ? 3.0 : 0.5)); }
 };
 
+/*
+class bohachevsky1
+{
+public:
+    auto operator() ( param a, param b ) const -> double
+    {
+        if (std::distance(a, b) != 2)
+            { throw std::logic_error("must have exactly 2 dimensions"); }
+        auto& x1 = *(a++);
+        auto& x2 = *a;
+        auto t1 = x1 * x1;
+        auto t2 = 2 * x2 * x2;
+        auto t3 = 0.3 * std::cos( THREE_PI * x1 + FOUR_PI * x2 );
+        double cost = t1 * t1 + t2 * t2 + t3 * t3;
+        return cost;
+    }
+    //auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-600.0, 600.0); }
+    //auto extremum ( unsigned i ) const -> double { return 0.0; }
+};
+*/
+
+class booth : public objective
+{
+public:
+    auto operator() ( param a, param b ) const -> double
+    {
+        if (std::distance(a, b) != 2)
+            { throw std::logic_error("must have exactly 2 dimensions"); }
+        auto& x1 = *(a++);
+        auto& x2 = *a;
+        auto t1 = x1 + 2 * x2 - 7;
+        auto t2 = 2 * x1 + x2 - 5;
+        double cost = t1 * t1 + t2 * t2;
+        return cost;
+    }
+    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); }
+    auto extremum ( unsigned i ) const -> double
+        { return (i == 0 ? 0.0 : (i == 1 ? 1.0 : 3.0)); }
+};
+
+class branin : public objective
+{
+public:
+    auto operator() ( param a, param b ) const -> double
+    {
+        if (std::distance(a, b) != 2)
+            { throw std::logic_error("must have exactly 2 dimensions"); }
+        auto& x1 = *(a++);
+        auto& x2 = *a;
+        auto t1 = 1.5 - x1 * (1 - x2);
+        auto t2 = 2.25 - x1 * (1 - x2 * x2);
+        auto t3 = 2.625 - x1 * (1-x2*x2*x2);
+        double cost = t1 * t1 + t2 * t2 + t3 * t3;
+        return cost;
+    }
+    auto domain ( unsigned i ) const -> domain_type
+        { return (i == 1 ? std::make_pair(-5.0, 10.0) : std::make_pair(-0.0, 15.0)); }
+    auto extremum ( unsigned i ) const -> double
+        { return (i == 0 ? 0.397887 : (i == 1 ? 9.42478 : 2.475)); }
+};
+
+class colville : public objective
+{
+public:
+    auto operator() ( param a, param b ) const -> double
+    {
+        if (std::distance(a, b) != 4)
+            { throw std::logic_error("must have exactly 4 dimensions"); }
+        auto& x1 = *(a++);
+        auto& x2 = *(a++);
+        auto& x3 = *(a++);
+        auto& x4 = *a;
+        auto t1 = x1 * x1 - x2;
+        auto t2 = x1 - 1;
+        auto t3 = x3 - 1;
+        auto t4 = x3 * x3 - x4;
+        auto t5 = x4 - 1;
+        auto t6 = x2 - 1;
+        double cost = 100.0 * t1 * t1 + t2 * t2 + t3 * t3 + 90.0 * t4 * t4
+            + 10.1 * (t3 * t3 + t5 * t5) + 19.8 * t6 * t5;
+        return cost;
+    }
+    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); }
+    auto extremum ( unsigned i ) const -> double { return (i == 0 ? 0.0 : 1.0); }
+};
+
+class dixon_price : public objective
+{
+public:
+    auto operator() ( param a, param b ) const -> double { return sum(a, b, unbounded()); }
+    auto bounded ( param a, param b, double bound ) const -> double { return sum(a, b, bound); }
+    void evaluate ( double const* x, std::size_t n, std::size_t d,
+                    std::size_t pitch, double* cost ) const
+    {
+        by_lanes(x, n, pitch, cost,
+            [d](double const* x, std::size_t pitch, std::size_t m, double* cost) {
+                double acc[LANES] = {};
+                for ( std::size_t j = 1; j < d; ++j ) {
+                    auto const i = unsigned(j + 1);
+                    for ( std::size_t k = 0; k < m; ++k ) {
+                        auto x1 = x[k * pitch + j - 1];
+                        auto x2 = x[k * pitch + j];
+                        auto t = 2 * x2 * x2 - x1;
+                        acc[k] = acc[k] + i * t * t;
+                    }
+                }
+                for ( std::size_t k = 0; k < m; ++k ) {
+                    auto c = x[k * pitch] - 1.0;
+                    cost[k] = c * c + acc[k];
+                }
+            }
+        );
+    }
+    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); }
+    auto extremum ( unsigned i ) const -> double { return 0.0; }
+private:
+    static auto sum ( param a, param b, double bound ) -> double
+    {
+        auto first = *a - 1.0;
+        first *= first;
+
+        auto rest = 0.0;
+        unsigned i = 1;
+        std::size_t const n = b - a;
+        for ( std::size_t j0 = 1; j0 < n; j0 += CHUNK ) {
+            std::size_t m = n - j0 < CHUNK ? n - j0 : CHUNK;
+            for ( std::size_t j = j0; j < j0 + m; ++j ) {
+                auto t = 2 * a[j] * a[j] - a[j-1];
+                rest = rest + (++i) * t * t;
+            }
+            if (beyond(first + rest, bound)) { break; }
+        }
+        return first + rest;
+    }
+};
+
+/** The n-dimensional benchmarks by name; nullptr for an unknown name. */
+inline auto make_objective ( std::string const& name ) -> objective*
+{
+    if (name == "sphere") { return new sphere(); }
+    if (name == "rosenbrock") { return new rosenbrock(); }
+    if (name == "rastrigin") { return new rastrigin(); }
+    if (name == "griewangk") { return new griewangk(); }
+    if (name == "ackley") { return new ackley(); }
+    if (name == "dixon_price") { return new dixon_price(); }
+    return nullptr;
+}
+
 #endif
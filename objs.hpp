@@ -1,5 +1,6 @@
 //#include "objective.hpp"
 #include "runnables.hpp"
+#include "simdmath.hpp"
 #include <algorithm>
 #include <forward_list>
 #include <iomanip>
@@ -98,7 +99,7 @@ public:
         auto cost = std::accumulate(a, b, 0.0,
             [](double sum, double x) {
                 static auto const TWOPI = 8.0 * std::atan(1.0);
-                return sum + x * x - 10.0 * std::cos(TWOPI * x);
+                return sum + x * x - 10.0 * simd::cos(TWOPI * x);
             }
         );            
         unsigned n = distance(a,b);
@@ -119,7 +120,7 @@ public:
         auto i = 0.0;
         auto cost2 = std::accumulate(a, b, 1.0,
             [&i](double prod, double x) {
-                return prod * std::cos(x / std::sqrt(++i));
+                return prod * simd::cos(x / simd::sqrt(++i));
             }
         );
         return cost1 - cost2 + 1.0;
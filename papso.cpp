@@ -1,332 +1,80 @@
-//#include "objective.hpp"
-#include "runnables.hpp"
+#include "channel.hpp"
+#include "cppscript.hpp"
+#include "kernel.hpp"
+#include "objective.hpp"
+#include "params.hpp"
+#include "philox.hpp"
+#include "population.hpp"
+#include "sharedbest.hpp"
+#include "stop.hpp"
+#include "tally.hpp"
 #include <algorithm>
-#include <forward_list>
-#include <iomanip>
+#include <atomic>
+#include <cstdlib>
 #include <iostream>
 #include <iterator>
 #include <memory>
-#include <mutex>
-#include <numeric>
 #include <random>
-#include <sstream>
-#include <system_error>
+#include <string>
+#include <thread>
 #include <vector>
 
-class swarm;
-
-class particle : protected std::vector<double>
-{
-protected:
-    using super = std::vector<double>;
-    using param = super::const_iterator;
-    using solution = std::pair<super::value_type,super>;
-    super velocity;
-public:
-    //using super::vector; // this should replace the constructors below
-    particle() : super() {}
-    particle(unsigned n)
-        : super(n), velocity(n,0),
-          local_best(std::numeric_limits<double>::infinity(),*this)
-        {}
-    using super::operator[];
-    using super::begin;
-    using super::cbegin;
-    using super::end;
-    using super::cend;
-    using super::size;
-    using super::const_iterator;
-    friend bool operator< ( solution const& a, solution const& b );
-    friend bool operator< ( double a, solution const& b );
-    friend bool operator< ( solution const& a, double b );
-private:
-    friend swarm;
-    solution local_best;
-};
-
-bool operator< ( particle::solution const& a, particle::solution const& b ) { return a.first < b.first; }
-bool operator< ( double a, particle::solution const& b ) { return a < b.first; }
-bool operator< ( particle::solution const& a, double b ) { return a.first < b; }
-
-struct objective
-{
-    using param = particle::const_iterator;
-    using domain_type = std::pair<double,double>;
-
-    virtual auto operator() ( param a, param b ) const -> double = 0;
-    virtual auto domain ( unsigned i ) const -> domain_type = 0;
-    virtual auto extremum ( unsigned i ) const -> double = 0;
-};
-
-class sphere : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        auto cost = std::inner_product(a, b, a, 0.0);
-        return cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-5.12, 5.12); }
-    auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
-
-class rosenbrock : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        auto cost = std::inner_product(a+1, b, a, 0.0,
-            std::plus<double>(),
-            [](double x2, double x1) {
-                auto t1 = x1 * x1  - x2;
-                auto t2 = x1 - 1.0;
-                return 100.0 * t1 * t1 + t2 * t2;
-            }
-        );
-        return cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-5.0, 10.0); }
-    auto extremum ( unsigned i ) const -> double { return (i == 0 ? 0.0 : 1.0); }
-};
-
-class rastrigin : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        auto cost = std::accumulate(a, b, 0.0,
-            [](double sum, double x) {
-                static auto const TWOPI = 8.0 * std::atan(1.0);
-                return sum + x * x - 10.0 * std::cos(TWOPI * x);
-            }
-        );            
-        unsigned n = distance(a,b);
-        return 10.0 * n + cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-5.12, 5.12); }
-    auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
-
-class griewangk : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        auto cost1 = std::accumulate(a, b, 0.0,
-            [](double sum, double x) { return sum + x * x  / 4000.0; }
-        );
-        auto i = 0.0;
-        auto cost2 = std::accumulate(a, b, 1.0,
-            [&i](double prod, double x) {
-                return prod * std::cos(x / std::sqrt(++i));
-            }
-        );
-        return cost1 - cost2 + 1.0;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-600.0, 600.0); }
-    auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
-
-class shaffer_f6 : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        auto x1 = *(a++), x2 = *a;
-        auto h = x1 * x1 + x2 * x2;
-        auto denom = 1 + 0.001 * h;
-        auto numer = std::sin(std::sqrt(h));  
-        auto cost = 0.5 + (numer * numer - 0.5) / (denom * denom);
-        return cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); } //!!
-    auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
-
-class shaffer_f6_inv : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        auto x1 = *(a++), x2 = *a;
-        auto h = x1 * x1 + x2 * x2;
-        auto denom = 1 + 0.001 * h;
-        auto numer = std::sin(std::sqrt(h));  
-        auto cost = 0.5 - (numer * numer - 0.5) / (denom * denom);
-        return cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); } //!!
-    auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
-
-class beale : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        if (std::distance(a, b) != 2)
-            { throw std::logic_error("must have exactly 2 dimensions"); }
-        auto& x1 = *(a++);
-        auto& x2 = *a;
-        auto t1 = 1.5 - x1 * (1 - x2);
-        auto t2 = 2.25 - x1 * (1 - x2 * x2);
-        auto t3 = 2.625 - x1 * (1-x2*x2*x2);
-        double cost = t1 * t1 + t2 * t2 + t3 * t3;
-        return cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-4.5, 4.5); }
-    auto extremum ( unsigned i ) const -> double
-        { return (i == 0 ? 0.0 : (i == 1 ? 3.0 : 0.5)); }
-};
-
-/*
-class bohachevsky1
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        if (std::distance(a, b) != 2)
-            { throw std::logic_error("must have exactly 2 dimensions"); }
-        auto& x1 = *(a++);
-        auto& x2 = *a;
-        auto t1 = x1 * x1;
-        auto t2 = 2 * x2 * x2;
-        auto t3 = 0.3 * std::cos( THREE_PI * x1 + FOUR_PI * x2 );
-        double cost = t1 * t1 + t2 * t2 + t3 * t3;
-        return cost;
-    }
-    //auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-600.0, 600.0); }
-    //auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
-*/
-
-class booth : public objective
+/** Parallel asynchronous PSO.
+ *
+ *  Worker threads pull particle indices from a shared queue, move and
+ *  evaluate that particle against whatever global best is published at
+ *  the time, offer the result back and requeue the index. Nobody waits
+ *  for the rest of the swarm, so a slow evaluation only holds up its own
+ *  particle. An index is in the queue at most once, so no two workers
+ *  ever touch the same row.
+ *
+ *  Each worker caches the global best position and refreshes it once
+ *  more than `staleness` improvements have landed since its copy; with
+ *  the default of 0 every update sees the latest best.
+ *
+ *  Decay follows the serial schedule: param.d updates in a row without a
+ *  global improvement multiply w by wd and vmax by vd. Only the number of
+ *  decays is shared; each worker replays it onto its own w and vmax, so
+ *  no parameter is written while others read it.
+ *
+ *  Everything a worker writes on every update lives on lines nobody else
+ *  writes: the per-particle counters and personal best costs get a line
+ *  each, and evaluations are counted per worker and summed every CHECK
+ *  updates for the budget test, which may overshoot by up to CHECK
+ *  evaluations per worker. The stop token is charged at the same points,
+ *  so a deadline or stop request ends the run within CHECK updates per
+ *  worker.
+ */
+class swarm
 {
 public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        if (std::distance(a, b) != 2)
-            { throw std::logic_error("must have exactly 2 dimensions"); }
-        auto& x1 = *(a++);
-        auto& x2 = *a;
-        auto t1 = x1 + 2 * x2 - 7;
-        auto t2 = 2 * x1 + x2 - 5;
-        double cost = t1 * t1 + t2 * t2;
-        return cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); }
-    auto extremum ( unsigned i ) const -> double
-        { return (i == 0 ? 0.0 : (i == 1 ? 1.0 : 3.0)); }
-};
-
-class branin : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        if (std::distance(a, b) != 2)
-            { throw std::logic_error("must have exactly 2 dimensions"); }
-        auto& x1 = *(a++);
-        auto& x2 = *a;
-        auto t1 = 1.5 - x1 * (1 - x2);
-        auto t2 = 2.25 - x1 * (1 - x2 * x2);
-        auto t3 = 2.625 - x1 * (1-x2*x2*x2);
-        double cost = t1 * t1 + t2 * t2 + t3 * t3;
-        return cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type
-        { return (i == 1 ? std::make_pair(-5.0, 10.0) : std::make_pair(-0.0, 15.0)); }
-    auto extremum ( unsigned i ) const -> double
-        { return (i == 0 ? 0.397887 : (i == 1 ? 9.42478 : 2.475)); }
-};
-
-class colville : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        if (std::distance(a, b) != 4)
-            { throw std::logic_error("must have exactly 4 dimensions"); }
-        auto& x1 = *(a++);
-        auto& x2 = *(a++);
-        auto& x3 = *(a++);
-        auto& x4 = *a;
-        auto t1 = x1 * x1 - x2;
-        auto t2 = x1 - 1;
-        auto t3 = x3 - 1;
-        auto t4 = x3 * x3 - x4;
-        auto t5 = x4 - 1;
-        auto t6 = x2 - 1;
-        double cost = 100.0 * t1 * t1 + t2 * t2 + t3 * t3 + 90.0 * t4 * t4
-            + 10.1 * (t3 * t3 + t5 * t5) + 19.8 * t6 * t5;
-        return cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); }
-    auto extremum ( unsigned i ) const -> double { return (i == 0 ? 0.0 : 1.0); }
-};
-
-class dixon_price : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        auto cost = *a - 1.0;
-        cost *= cost;
-
-        unsigned i = 1;
-        cost += std::inner_product(a+1, b, a, 0.0,
-            std::plus<double>(),
-            [&i](double x2, double x1) {
-                auto t = 2 * x2 * x2 - x1;
-                return (++i) * t * t;
-            }
-        );
-        return cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); }
-    auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
-
-class swarm : std::vector<particle>
-{
-    using super = std::vector<particle>;
-public:
-    struct param_type
-    {
-        /* Population size */
-        double n;
-        /* Cognitive trust parameter */
-        double c1;
-        /* Social trust parameter */
-        double c2;
-        /* Current inertia */
-        double w;
-        /* Initial inertia */
-        double w0;
-        /* Inertial decay */
-        double wd;
-        /* Velocity fraction */
-        double k;
-        /* Velocity decay */
-        double vd;
-        /* Decay delay in iterations */
-        long d;
-    };
+    using solution = std::pair<double,std::vector<double>>;
+    using param_type = pso_param;
 
     explicit swarm ( int d, objective* f = new sphere(),
-                      param_type p = {20,2.0,2.0,1.0,1.0,0.95,0.5,0.95,200} )
-        : super(p.n, d), param(p), f(f), leader(begin()),
-          vmax(d, 0.0), rng(std::random_device()())
+                      param_type p = {20,2.0,2.0,1.0,1.0,0.95,0.5,0.95,200},
+                      unsigned threads = std::thread::hardware_concurrency(),
+                      unsigned long staleness = 0,
+                      std::uint64_t seed = std::random_device()() )
+        : param(p), f(f), pop(p.n, d), slots(pop.size()),
+          queue(pop.size()), global(d), threads(std::max(1U, threads)),
+          staleness(staleness), evaluations(this->threads), stagnant(0), decays(0),
+          done(false), rng(seed)
     {
         auto i = 0L;
-        std::generate(vmax.begin(), vmax.end(), [&i,this](){
+        std::generate(pop.vmax.begin(), pop.vmax.begin() + d, [&i,this](){
             auto bounds = this->f->domain(i++);
             auto range = bounds.second - bounds.first;
             return range * param.k;
         });
     }
 
-    particle::solution best_solution() { return leader->local_best; }
+    solution best_solution() const
+    {
+        solution best(0.0, std::vector<double>(pop.dimensions()));
+        best.first = global.read(best.second.data());
+        return best;
+    }
 
     void operator() ()
     {
@@ -338,142 +86,210 @@ public:
                   << param.wd << ' '
                   << param.k << ' '
                   << param.vd << ' '
-                  << param.d << std::endl;
+                  << param.d << ' '
+                  << threads << ' '
+                  << staleness << std::endl;
         initialize();
 
-        auto k = 0LL, t = 0LL;
-        do {
-            for ( auto i = begin(); i != end(); ++i, ++k ) {
-                if ( update(i) ) {
-                    t = 0;
-                } else {
-                    ++t;
-                }
-                if (t == param.d) {
-                    t = 0;
-                    param.w  *= param.wd;
-                    for ( auto& vm : vmax ) {
-                        vm *= param.vd;
-                    }
-                }
+        std::vector<std::thread> pool;
+        for ( auto id = 1U; id < threads; ++id ) { pool.emplace_back(&swarm::work, this, id); }
+        work(0);
+        for ( auto& t : pool ) { t.join(); }
 
-                if (leader->local_best.first < 0.1 || k > 640000) {
-                    std::cerr << k << std::endl;
-                    return;
-                }
-            }
-        } while (true);
+        std::cerr << evaluations.total() << std::endl;
     }
 
+    /** Deadline, budget and stop requests for the run. */
+    auto stop() const -> stop_token const& { return token; }
+
+    /** Evaluations and best cost so far; safe to read while running. */
+    auto spent() const -> long long { return evaluations.total(); }
+    auto best_cost() const -> double { return global.cost(); }
+
 private:
-    bool update ( iterator i )
+    /* updates between looks at the evaluation total */
+    static long const CHECK = 64;
+
+    /* Hot scalars of one particle, a cache line each */
+    struct slot
     {
-        // compute velocity
-        {
-            auto xi = i->cbegin();
-            auto vm = vmax.cbegin();
-            auto p = i->local_best.second.cbegin();
-            auto g = leader->local_best.second.cbegin();
-            std::transform(i->velocity.cbegin(), i->velocity.cend(),
-                           i->velocity.begin(),
-                           [&,this](double vprev){
-                auto r1 = std::generate_canonical<double,16>(rng);
-                auto r2 = std::generate_canonical<double,16>(rng);
-                auto x = *xi++;
-                auto vmax = *vm++;
-                auto v = vprev * param.w
-                    + r1 * param.c1 * (*p++ - x)
-                    + r2 * param.c2 * (*g++ - x);
-                return std::max( std::min( v, vmax ), -vmax );
-            });
+        slot() : sweep(0), best(0.0) {}
+        long long sweep;
+        double best;
+        char padding[64 - sizeof(long long) - sizeof(double)];
+    };
+
+    /* Per-worker view of the shared state */
+    struct view
+    {
+        view ( population const& pop, unsigned id )
+            : r1(pop.dimensions()), r2(pop.dimensions()), g(pop.dimensions()),
+              vmax(pop.vmax), w(0.0), decays(0), seen(0), id(id), updates(0) {}
+
+        aligned_vector<double> r1;
+        aligned_vector<double> r2;
+        aligned_vector<double> g;
+        aligned_vector<double> vmax;
+        double w;
+        long decays;
+        std::uint64_t seen;
+        unsigned id;
+        long updates;
+    };
+
+    void work ( unsigned id )
+    {
+        view mine(pop, id);
+        mine.w = param.w;
+        mine.seen = global.version();
+        global.read(mine.g.data());
+
+        std::size_t i;
+        while (!done.load(std::memory_order_relaxed)) {
+            if (!queue.try_pop(i)) {
+                std::this_thread::yield();
+                continue;
+            }
+            refresh(mine);
+            update(i, mine);
+            queue.try_push(i);
         }
+    }
 
-        // update position
-        std::transform(i->cbegin(), i->cend(), i->velocity.cbegin(),
-                       i->begin(), std::plus<double>());
-        // compute cost
-        auto cost = (*f)(i->begin(), i->end());
-        // update personal best
-        if ( cost < i->local_best ) {
-            i->local_best.second.assign(i->cbegin(),i->cend());
-            i->local_best.first = cost;
-            // update global best
-            if ( cost < leader->local_best ) {
-                leader = i;
+    void refresh ( view& mine )
+    {
+        // global best, once our copy is too far behind
+        auto v = global.version();
+        if (v - mine.seen > staleness) {
+            mine.seen = v;
+            global.read(mine.g.data());
+        }
+        // decays applied since our last update, in the serial order
+        auto m = decays.load(std::memory_order_relaxed);
+        for ( ; mine.decays < m; ++mine.decays ) {
+            mine.w *= param.wd;
+            for ( auto& vm : mine.vmax ) {
+                vm *= param.vd;
             }
-            if (leader == i) { return true; }
         }
-        return false;
+    }
+
+    void update ( std::size_t i, view& mine )
+    {
+        auto const n = pop.dimensions();
+        auto x = pop.position.row(i);
+        auto v = pop.velocity.row(i);
+
+        // draw this particle's coefficients for its next sweep
+        auto const s = ++slots[i].sweep;
+        rng.fill(i, s, philox::COGNITIVE, mine.r1.data(), n);
+        rng.fill(i, s, philox::SOCIAL, mine.r2.data(), n);
+
+        // compute velocity and update position
+        kernel::update()(x, v, pop.best.row(i), mine.g.data(),
+                         mine.vmax.data(), mine.r1.data(), mine.r2.data(),
+                         mine.w, param.c1, param.c2, n);
+        // compute cost
+        auto cost = (*f)(x, x + n);
+        evaluations.add(mine.id);
+        // update personal best, and the global best if strictly better
+        auto improved = false;
+        if ( cost < slots[i].best ) {
+            std::copy(x, x + n, pop.best.row(i));
+            slots[i].best = cost;
+            improved = global.offer(cost, pop.best.row(i));
+        }
+        if (improved) {
+            stagnant.store(0, std::memory_order_relaxed);
+        } else if (stagnant.fetch_add(1, std::memory_order_relaxed) + 1 == param.d) {
+            stagnant.store(0, std::memory_order_relaxed);
+            decays.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (global.cost() < 0.1
+            || (++mine.updates % CHECK == 0
+                && (evaluations.total() > 640000 || token.charge(CHECK)))) {
+            done.store(true, std::memory_order_relaxed);
+        }
     }
 
     void initialize()
     {
         randomize();
-        for ( auto i = begin(); i != end(); ++i) {
-            // compute cost
-            auto cost = (*f)(i->begin(), i->end());
+        auto const n = pop.dimensions();
+        // compute cost
+        f->evaluate(pop.position.data(), pop.size(), n, pop.position.pitch(),
+                    pop.cost.data());
+        for ( auto i = 0UL; i < pop.size(); ++i ) {
             // update personal best
-            i->local_best.second.assign(i->cbegin(),i->cend());
-            i->local_best.first = cost;
-            if (cost < leader->local_best) {
-                leader = i;
-            }
+            std::copy(pop.position.row(i), pop.position.row(i) + n, pop.best.row(i));
+            pop.best_cost[i] = pop.cost[i];
+            slots[i].best = pop.cost[i];
+            global.offer(pop.cost[i], pop.best.row(i));
+            queue.try_push(i);
         }
     }
 
     void randomize()
     {
-        std::uniform_real_distribution<> dis;
-        for ( auto& p : *this )
+        auto const n = pop.dimensions();
+        for ( auto i = 0UL; i < pop.size(); ++i )
         {
-            auto i = 0U;
-            std::generate(p.begin(), p.end(), [&i,&dis,this](){
-                dis.param(std::uniform_real_distribution<>::param_type(
-                    f->domain(i).first, f->domain(i).second
-                ));
-                ++i;
-                return dis(rng);
-            });
+            auto x = pop.position.row(i);
+            rng.fill(i, 0, philox::POSITION, x, n);
+            for ( auto j = 0U; j < n; ++j ) {
+                auto bounds = f->domain(j);
+                x[j] = bounds.first + x[j] * (bounds.second - bounds.first);
+            }
         }
-        for ( auto& p : *this )
+        for ( auto i = 0UL; i < pop.size(); ++i )
         {
-            auto vm = vmax.cbegin();
-            std::generate(p.velocity.begin(), p.velocity.end(), [&,this](){
-                dis.param(std::uniform_real_distribution<>::param_type( -*vm, *vm ));
-                ++vm;
-                return dis(rng);
-            });
+            auto v = pop.velocity.row(i);
+            rng.fill(i, 0, philox::VELOCITY, v, n);
+            for ( auto j = 0U; j < n; ++j ) {
+                auto vm = pop.vmax[j];
+                v[j] = -vm + v[j] * (vm + vm);
+            }
         }
     }
 
     param_type param;
     std::unique_ptr<objective> f;
-    super::iterator leader;
-    std::vector<double> vmax;
-    std::mt19937 rng;
+    population pop;
+    aligned_vector<slot> slots;
+    channel<std::size_t> queue;
+    shared_best global;
+    unsigned const threads;
+    std::uint64_t const staleness;
+    tally evaluations;
+    std::atomic<long> stagnant;
+    std::atomic<long> decays;
+    std::atomic<bool> done;
+    stop_token token;
+    philox rng;
 };
 
 int main (int argc, char** argv)
 {
-    /*
-    int const N = atoi(argv[1]);
-    double w0, c1, c2;
-    std::istringstream arg(argv[2]);
-    arg >> w0;
-    arg.str(argv[3]);
-    arg >> c1;
-    arg.str(argv[4]);
-    arg >> c2;
-    */
-
-    swarm s { 64, new griewangk() };
+    // papso [threads [staleness [seconds [report millis]]]]
+    unsigned const threads = argc > 1 ? atoi(argv[1]) : std::thread::hardware_concurrency();
+    unsigned long const staleness = argc > 2 ? atol(argv[2]) : 0;
+
+    swarm s { 64, new griewangk(), {20,2.0,2.0,1.0,1.0,0.95,0.5,0.95,200}, threads, staleness };
+    if (argc > 3) { s.stop().time_limit(atof(argv[3])); }
+    cppscript::interval report;
+    if (argc > 4 && atoi(argv[4]) > 0) {
+        report = cppscript::set_interval([&s]{
+            std::cerr << s.spent() << ' ' << s.best_cost() << std::endl;
+        }, atoi(argv[4]));
+    }
     s();
+    cppscript::clear_interval(report);
 
-    //double bestcost = s.best_solution().first;
-    //auto const& best = s.best_solution().second;
-    //std::cout << bestcost << std::endl;
-    //std::copy(best.cbegin(), best.cend(), std::ostream_iterator<double>(std::cout," "));
-    //std::cout << std::endl;
+    auto best = s.best_solution();
+    std::cout << best.first << std::endl;
+    std::copy(best.second.cbegin(), best.second.cend(), std::ostream_iterator<double>(std::cout," "));
+    std::cout << std::endl;
 
     return 0;
 }
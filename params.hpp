@@ -0,0 +1,27 @@
+#ifndef HPP_PARAMS
+#define HPP_PARAMS
+
+/** Tuning parameters shared by the swarm engines. */
+struct pso_param
+{
+    /* Population size */
+    double n;
+    /* Cognitive trust parameter */
+    double c1;
+    /* Social trust parameter */
+    double c2;
+    /* Current inertia */
+    double w;
+    /* Initial inertia */
+    double w0;
+    /* Inertial decay */
+    double wd;
+    /* Velocity fraction */
+    double k;
+    /* Velocity decay */
+    double vd;
+    /* Decay delay in iterations */
+    long d;
+};
+
+#endif
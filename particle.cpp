@@ -8,15 +8,17 @@ int main ()
     p2[0] = 5.0;
     //p2.at(1) = 2.5;
 
-    std::shared_ptr<swarmer> s1 {new swarmer};
-    std::shared_ptr<swarmer> s2 {new swarmer(*s1)};
+    swarmer::swarm members;
+    auto& s1 = members.emplace();
+    auto& s2 = members.emplace(s1);
+    s1.stop().time_limit(0.1);   // shared with s2
 
     //s1.start_swarming();
     //s1.join();
-    s1->run();
-    s2->run();
-    s1->join();
-    s2->join();
+    s1.run();
+    s2.run();
+    s1.join();
+    s2.join();
 
     return 0;
 }
@@ -2,14 +2,14 @@
 #define HPP_PARTICLE
 
 #include <algorithm>
-#include <forward_list>
 #include <functional>
 #include <iostream>
 #include <memory> 
-#include <mutex>
 #include <numeric>
 #include <random>
 #include <vector>
+#include "logger.hpp"
+#include "registry.hpp"
 #include "runnables.hpp"
 
 class particle : protected std::vector<double>
@@ -36,16 +36,16 @@ bool operator< ( particle::solution a, particle::solution b )
 { return a.first < b.first; }
 
 
+/** A particle of a swarm held in a registry<swarmer>, which owns it. */
 class swarmer
-    : public std::enable_shared_from_this<swarmer>,
-      public runnable,
-      particle,
-      std::recursive_mutex
+    : public runnable,
+      particle
 {
-    using swarm = std::forward_list<std::shared_ptr<swarmer>>;
     using cost_function = std::function<double(param,param)>;
 public:
-    explicit swarmer ( cost_function f =
+    using swarm = registry<swarmer>;
+
+    explicit swarmer ( swarm& members, std::size_t index, cost_function f =
         std::bind(std::accumulate<std::vector<double>::const_iterator,
                                 double,
                                 std::plus<double>
@@ -55,42 +55,40 @@ public:
                                 0,std::plus<double>())
      )
         : objective(f),
-          leader(this),
-          neighbors(new swarm(1,std::shared_ptr<swarmer>(this))),
+          members(members),
+          index(index),
           local_best(std::numeric_limits<double>::infinity(),*this)
     {}
 
-    explicit swarmer ( swarmer const& p )
-        : objective(p.objective),
-          leader(const_cast<swarmer&>(p).shared_from_this()),
+    /** Another member of the same swarm as p. */
+    swarmer ( swarm& members, std::size_t index, swarmer const& p )
+        : runnable(p.stop()),
+          objective(p.objective),
+          members(members),
+          index(index),
           local_best(std::numeric_limits<double>::infinity(),*this)
-    { leader->neighbors->push_front(std::shared_ptr<swarmer>(this)); }
+    {}
 
-    void start_swarming() { for ( auto s : *(leader->neighbors) ) { s->run(); } }
-    void watch() { for ( auto s : *(leader->neighbors) ) { s->join(); } }
+    void start_swarming() { for ( auto i = 0UL; i < members.size(); ++i ) { members[i].run(); } }
+    void watch() { for ( auto i = 0UL; i < members.size(); ++i ) { members[i].join(); } }
     using runnable::join;
 
 protected:
-    void operator() () { while (true) { update(); } }
-
-    void update()
+    /* until the shared stop token expires; it is looked at every CHECK updates */
+    void operator() ()
     {
-        std::cerr << get_id() << std::endl;
-        auto cost = objective(begin(), end());
-        if ( cost < local_best.first )
-            { local_best = solution(cost,*this); }
-        if ( local_best < leader->local_best )
-            { promote(); }
+        stop_poll poll(stop(), CHECK);
+        do { update(); } while (!poll());
     }
 
-    void promote ()
+    void update()
     {
-        leader->lock();
-        swarmer& former_leader = *leader;
-        for ( auto s : *(former_leader.neighbors) )
-            { s->leader = shared_from_this(); }
-        neighbors = std::move(former_leader.neighbors);
-        former_leader.unlock();
+        auto cost = objective(begin(), end());
+        logger::standard().write("update", index, cost);
+        if ( cost < local_best.first ) {
+            local_best = solution(cost,*this);
+            members.lead(index, cost);
+        }
     }
 
     void demote()
@@ -113,11 +111,12 @@ protected:
     }
 
     cost_function objective;
-    std::shared_ptr<swarmer> leader;
-    std::unique_ptr<swarm> neighbors;
+    swarm& members;
+    std::size_t index;
     solution local_best;
     std::mt19937 rng;
 
+    static unsigned const CHECK = 64;
     constexpr static double const INERTIA = 0.86;
     constexpr static double const P_AFFINITY = 0.45;
     constexpr static double const G_AFFINITY = 0.25;
@@ -0,0 +1,109 @@
+#ifndef HPP_PHILOX
+#define HPP_PHILOX
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+
+/** Counter-based random streams (Philox4x32-10, Salmon et al. 2011).
+ *
+ *  A draw is a pure function of (seed, particle, iteration, tag, dimension),
+ *  so there is no generator state to carry between calls or threads: any
+ *  thread that updates particle i at iteration t sees exactly the same
+ *  numbers, however particles are spread over workers. Each Philox block
+ *  yields two doubles, and fill() runs several blocks side by side through
+ *  GCC vector extensions.
+ */
+class philox
+{
+public:
+    using result_type = std::uint64_t;
+
+    /* Independent streams per (particle, iteration) */
+    enum tag : std::uint32_t
+    {
+        COGNITIVE = 0,
+        SOCIAL = 1,
+        POSITION = 2,
+        VELOCITY = 3,
+        MIGRATION = 4,
+        TOPOLOGY = 5
+    };
+
+    explicit philox ( std::uint64_t seed = std::random_device()() )
+        : k0(std::uint32_t(seed)), k1(std::uint32_t(seed >> 32)) {}
+
+    auto seed() const -> std::uint64_t { return (std::uint64_t(k1) << 32) | k0; }
+
+    /** out[j] = uniform [0,1) number j of the given stream, for j < n. */
+    void fill ( std::uint64_t particle, std::uint64_t iteration, tag t,
+                double* out, std::size_t n ) const
+    {
+        std::uint64_t const c1 = t, c2 = std::uint32_t(particle),
+                            c3 = std::uint32_t(iteration);
+        std::size_t j = 0;
+        for ( ; j + 2 * WIDTH <= n; j += 2 * WIDTH ) {
+            vword c0;
+            for ( std::size_t l = 0; l < WIDTH; ++l ) { c0[l] = (j >> 1) + l; }
+            vword x[4] = { c0, c0 * 0 + c1, c0 * 0 + c2, c0 * 0 + c3 };
+            rounds(x);
+            for ( std::size_t l = 0; l < WIDTH; ++l ) {
+                out[j + 2 * l] = to_unit(x[0][l], x[1][l]);
+                out[j + 2 * l + 1] = to_unit(x[2][l], x[3][l]);
+            }
+        }
+        for ( ; j < n; j += 2 ) {
+            std::uint64_t x[4] = { j >> 1, c1, c2, c3 };
+            rounds(x);
+            out[j] = to_unit(x[0], x[1]);
+            if (j + 1 < n) { out[j + 1] = to_unit(x[2], x[3]); }
+        }
+    }
+
+    /** Uniform [0,1) number for a single dimension of a stream. */
+    auto operator() ( std::uint64_t particle, std::uint64_t iteration, tag t,
+                      std::uint64_t dimension ) const -> double
+    {
+        std::uint64_t x[4] = { dimension >> 1, t, std::uint32_t(particle),
+                               std::uint32_t(iteration) };
+        rounds(x);
+        return dimension & 1 ? to_unit(x[2], x[3]) : to_unit(x[0], x[1]);
+    }
+
+private:
+    using vword = std::uint64_t __attribute__((vector_size(32)));
+    static std::size_t const WIDTH = sizeof(vword) / sizeof(std::uint64_t);
+
+    static std::uint64_t const M0 = 0xD2511F53;
+    static std::uint64_t const M1 = 0xCD9E8D57;
+    static std::uint32_t const W0 = 0x9E3779B9;
+    static std::uint32_t const W1 = 0xBB67AE85;
+
+    /* Ten Philox rounds on 32-bit words held in 64-bit slots, so scalar and
+     * vector lanes share one definition. */
+    template <typename T>
+    void rounds ( T (&x)[4] ) const
+    {
+        std::uint32_t a = k0, b = k1;
+        for ( int r = 0; r < 10; ++r ) {
+            T p0 = x[0] * M0;
+            T p1 = x[2] * M1;
+            T y0 = ((p1 >> 32) ^ x[1] ^ a) & 0xFFFFFFFF;
+            T y1 = p1 & 0xFFFFFFFF;
+            T y2 = ((p0 >> 32) ^ x[3] ^ b) & 0xFFFFFFFF;
+            T y3 = p0 & 0xFFFFFFFF;
+            x[0] = y0; x[1] = y1; x[2] = y2; x[3] = y3;
+            a += W0;
+            b += W1;
+        }
+    }
+
+    static auto to_unit ( std::uint64_t hi, std::uint64_t lo ) -> double
+        { return double(((hi << 32) | lo) >> 11) * (1.0 / 9007199254740992.0); }
+
+    std::uint32_t k0;
+    std::uint32_t k1;
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef HPP_POPULATION
+#define HPP_POPULATION
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <vector>
+
+/** Allocator handing out storage aligned to (at least) a cache line and
+ *  padded to whole lines, so that no two blocks ever share one. */
+template <typename T, std::size_t Align = 64>
+struct aligned_allocator
+{
+    using value_type = T;
+
+    template <typename U>
+    struct rebind { using other = aligned_allocator<U,Align>; };
+
+    aligned_allocator() = default;
+    template <typename U>
+    aligned_allocator ( aligned_allocator<U,Align> const& ) {}
+
+    auto allocate ( std::size_t n ) -> T*
+    {
+        void* p = nullptr;
+        if (n > (std::numeric_limits<std::size_t>::max() - Align) / sizeof(T)
+            || posix_memalign(&p, Align, (n * sizeof(T) + Align - 1) / Align * Align) != 0)
+            { throw std::bad_alloc(); }
+        return static_cast<T*>(p);
+    }
+    void deallocate ( T* p, std::size_t ) { std::free(p); }
+};
+
+template <typename T, typename U, std::size_t A>
+bool operator== ( aligned_allocator<T,A> const&, aligned_allocator<U,A> const& ) { return true; }
+template <typename T, typename U, std::size_t A>
+bool operator!= ( aligned_allocator<T,A> const&, aligned_allocator<U,A> const& ) { return false; }
+
+template <typename T>
+using aligned_vector = std::vector<T,aligned_allocator<T>>;
+
+/** Row-major N x D matrix of doubles; every row starts on a cache line.
+ *  Rows are padded with zeros up to pitch() so that whole-row loops never
+ *  straddle a neighbour's line. */
+class matrix
+{
+public:
+    static std::size_t const LANES = 64 / sizeof(double);
+
+    matrix() : n(0), d(0), stride(0) {}
+    matrix ( std::size_t rows, std::size_t cols, double value = 0.0 )
+        : n(rows), d(cols), stride((cols + LANES - 1) / LANES * LANES),
+          storage(rows * stride, 0.0)
+    {
+        for ( std::size_t i = 0; i < n; ++i )
+            { std::fill(row(i), row(i) + d, value); }
+    }
+
+    auto row ( std::size_t i ) -> double* { return storage.data() + i * stride; }
+    auto row ( std::size_t i ) const -> double const* { return storage.data() + i * stride; }
+
+    auto rows() const -> std::size_t { return n; }
+    auto cols() const -> std::size_t { return d; }
+    auto pitch() const -> std::size_t { return stride; }
+
+    auto data() -> double* { return storage.data(); }
+    auto data() const -> double const* { return storage.data(); }
+
+private:
+    std::size_t n;
+    std::size_t d;
+    std::size_t stride;
+    aligned_vector<double> storage;
+};
+
+/** Structure-of-arrays swarm state: one contiguous matrix per quantity
+ *  instead of three heap vectors per particle. */
+struct population
+{
+    population ( std::size_t n, std::size_t d )
+        : position(n, d), velocity(n, d), best(n, d),
+          cost(n, std::numeric_limits<double>::infinity()),
+          best_cost(n, std::numeric_limits<double>::infinity()),
+          vmax(position.pitch(), 0.0)
+        {}
+
+    auto size() const -> std::size_t { return position.rows(); }
+    auto dimensions() const -> std::size_t { return position.cols(); }
+
+    /* Current particle positions */
+    matrix position;
+    /* Current particle velocities */
+    matrix velocity;
+    /* Personal best positions */
+    matrix best;
+    /* Cost of the current positions */
+    aligned_vector<double> cost;
+    /* Cost of the personal best positions */
+    aligned_vector<double> best_cost;
+    /* Per-dimension velocity limit (padded to pitch) */
+    aligned_vector<double> vmax;
+};
+
+#endif
@@ -0,0 +1,215 @@
+#ifndef HPP_PROBE
+#define HPP_PROBE
+
+#include "population.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <ostream>
+
+/** Hot-path instrumentation: phase timers, event counters and a latency
+ *  histogram of evaluations, kept per thread.
+ *
+ *  Compiled in with -DPSO_PROBES; without it every type here is empty and
+ *  every call an inline no-op, so the engines pay nothing. A sheet has a
+ *  single writer, the thread that owns it, which updates it with plain
+ *  relaxed loads and stores on lines nobody else writes (as tally does),
+ *  and any thread may add it into a summary at any time. Counters are
+ *  exact; phases are timed on one update in SAMPLE, which keeps the clock
+ *  reads well under the cost of an evaluation.
+ */
+namespace probe
+{
+
+enum phase { velocity, position, evaluation, best, lock_wait, PHASES };
+enum counter { evaluations, improvements, leader_changes, decays, COUNTERS };
+
+/* histogram buckets: [2^b, 2^(b+1)) nanoseconds */
+std::size_t const BUCKETS = 32;
+/* one update in SAMPLE has its phases timed */
+unsigned const SAMPLE = 16;
+
+#ifdef PSO_PROBES
+
+class summary;
+
+class sheet
+{
+public:
+    sheet() : tick(0)
+    {
+        for ( auto& t : times ) { t.store(0, std::memory_order_relaxed); }
+        for ( auto& c : counts ) { c.store(0, std::memory_order_relaxed); }
+        for ( auto& h : histogram ) { h.store(0, std::memory_order_relaxed); }
+        timed.store(0, std::memory_order_relaxed);
+    }
+
+    void count ( counter c, long long n = 1 ) { bump(counts[c], n); }
+
+    /** True on the updates whose phases should be timed. */
+    bool sample() { return tick++ % SAMPLE == 0; }
+
+    /** Charge ns nanoseconds to phase p of a sampled update. */
+    void time ( phase p, long long ns )
+    {
+        bump(times[p], ns);
+        if (p == evaluation) {
+            auto b = std::size_t(0);
+            while (b + 1 < BUCKETS && (ns >> (b + 1)) > 0) { ++b; }
+            bump(histogram[b], 1);
+        }
+    }
+
+    /** One more sampled update. */
+    void timed_update() { bump(timed, 1); }
+
+private:
+    friend class summary;
+
+    static void bump ( std::atomic<long long>& a, long long n )
+        { a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+
+    std::atomic<long long> times[PHASES];
+    std::atomic<long long> counts[COUNTERS];
+    std::atomic<long long> histogram[BUCKETS];
+    std::atomic<long long> timed;
+    unsigned long long tick;
+    char padding[64 - (PHASES + COUNTERS + BUCKETS + 2) * 8 % 64];
+};
+
+/** Times the phases of one update, if the sheet samples it: each lap()
+ *  charges the time since the previous lap (or construction) to a phase. */
+class stopwatch
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit stopwatch ( sheet& s ) : s(s), on(s.sample())
+    {
+        if (on) {
+            s.timed_update();
+            last = clock::now();
+        }
+    }
+
+    void lap ( phase p )
+    {
+        if (!on) { return; }
+        auto now = clock::now();
+        s.time(p, std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count());
+        last = now;
+    }
+
+    /** Restart without charging anything, to leave out what came since. */
+    void skip() { if (on) { last = clock::now(); } }
+
+private:
+    sheet& s;
+    bool on;
+    clock::time_point last;
+};
+
+/** Sheets added together; plain numbers, for reporting. */
+class summary
+{
+public:
+    summary() : timed(0)
+    {
+        for ( auto& t : times ) { t = 0; }
+        for ( auto& c : counts ) { c = 0; }
+        for ( auto& h : histogram ) { h = 0; }
+    }
+
+    summary& operator+= ( sheet const& s )
+    {
+        for ( auto p = 0U; p < PHASES; ++p ) { times[p] += s.times[p].load(std::memory_order_relaxed); }
+        for ( auto c = 0U; c < COUNTERS; ++c ) { counts[c] += s.counts[c].load(std::memory_order_relaxed); }
+        for ( auto b = 0U; b < BUCKETS; ++b ) { histogram[b] += s.histogram[b].load(std::memory_order_relaxed); }
+        timed += s.timed.load(std::memory_order_relaxed);
+        return *this;
+    }
+
+    auto operator[] ( counter c ) const -> long long { return counts[c]; }
+    /** Mean nanoseconds per sampled update spent in phase p. */
+    auto mean ( phase p ) const -> double { return timed ? double(times[p]) / timed : 0.0; }
+
+    void print ( std::ostream& out ) const
+    {
+        static char const* const phases[] = { "velocity", "position", "evaluation", "best", "lock wait" };
+        static char const* const counters[] = { "evaluations", "improvements", "leader changes", "decays" };
+        auto flags = out.flags();
+        out << std::fixed << std::setprecision(1);
+        for ( auto p = 0U; p < PHASES; ++p )
+            { out << std::setw(16) << phases[p] << std::setw(12) << mean(phase(p)) << " ns" << std::endl; }
+        for ( auto c = 0U; c < COUNTERS; ++c )
+            { out << std::setw(16) << counters[c] << std::setw(12) << counts[c] << std::endl; }
+        for ( auto b = 0U; b < BUCKETS; ++b ) {
+            if (histogram[b]) {
+                out << std::setw(13) << (1LL << b) << " ns" << std::setw(12) << histogram[b] << std::endl;
+            }
+        }
+        out.flags(flags);
+    }
+
+private:
+    long long times[PHASES];
+    long long counts[COUNTERS];
+    long long histogram[BUCKETS];
+    long long timed;
+};
+
+#else
+
+class sheet
+{
+public:
+    void count ( counter, long long = 1 ) {}
+    bool sample() { return false; }
+    void time ( phase, long long ) {}
+    void timed_update() {}
+};
+
+class stopwatch
+{
+public:
+    explicit stopwatch ( sheet& ) {}
+    void lap ( phase ) {}
+    void skip() {}
+};
+
+class summary
+{
+public:
+    summary& operator+= ( sheet const& ) { return *this; }
+    auto operator[] ( counter ) const -> long long { return 0; }
+    auto mean ( phase ) const -> double { return 0.0; }
+    void print ( std::ostream& ) const {}
+};
+
+#endif
+
+/** One sheet per thread, each on lines of its own. */
+class board
+{
+public:
+    explicit board ( std::size_t slots ) : sheets(slots ? slots : 1) {}
+
+    /** Only ever written by the one thread that owns `slot`. */
+    auto operator[] ( std::size_t slot ) -> sheet& { return sheets[slot]; }
+    auto size() const -> std::size_t { return sheets.size(); }
+
+    auto total() const -> summary
+    {
+        summary s;
+        for ( auto const& h : sheets ) { s += h; }
+        return s;
+    }
+
+private:
+    aligned_vector<sheet> sheets;
+};
+
+}
+
+#endif
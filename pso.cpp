@@ -1,5 +1,6 @@
-//#include "objective.hpp"
-#include "runnables.hpp"
+#include "evalcache.hpp"
+#include "fixedswarm.hpp"
+#include "pso.hpp"
 #include <algorithm>
 #include <forward_list>
 #include <iomanip>
@@ -10,470 +11,142 @@
 #include <numeric>
 #include <random>
 #include <sstream>
+#include <string>
 #include <system_error>
 #include <vector>
 
-class swarm;
+/* phase times and counters on stderr, when built with -DPSO_PROBES */
+template <typename Engine>
+void profile ( Engine const& ) {}
+void profile ( swarm const& s ) { (probe::summary() += s.instruments()).print(std::cerr); }
 
-class particle : protected std::vector<double>
+template <typename Engine>
+int report ( Engine& s )
 {
-protected:
-    using super = std::vector<double>;
-    using param = super::const_iterator;
-    using solution = std::pair<super::value_type,super>;
-    super velocity;
-public:
-    //using super::vector; // this should replace the constructors below
-    particle() : super() {}
-    particle(unsigned n)
-        : super(n), velocity(n,0),
-          local_best(std::numeric_limits<double>::infinity(),*this)
-        {}
-    using super::operator[];
-    using super::begin;
-    using super::cbegin;
-    using super::end;
-    using super::cend;
-    using super::size;
-    using super::const_iterator;
-    friend bool operator< ( solution const& a, solution const& b );
-    friend bool operator< ( double a, solution const& b );
-    friend bool operator< ( solution const& a, double b );
-private:
-    friend swarm;
-    solution local_best;
-};
-
-bool operator< ( particle::solution const& a, particle::solution const& b ) { return a.first < b.first; }
-bool operator< ( double a, particle::solution const& b ) { return a < b.first; }
-bool operator< ( particle::solution const& a, double b ) { return a.first < b; }
-
-struct objective
-{
-    using param = particle::const_iterator;
-    using domain_type = std::pair<double,double>;
-
-    virtual auto operator() ( param a, param b ) const -> double = 0;
-    virtual auto domain ( unsigned i ) const -> domain_type = 0;
-    virtual auto extremum ( unsigned i ) const -> double = 0;
-};
-
-class sphere : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        auto cost = std::inner_product(a, b, a, 0.0);
-        return cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-5.12, 5.12); }
-    auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
-
-class rosenbrock : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        auto cost = std::inner_product(a+1, b, a, 0.0,
-            std::plus<double>(),
-            [](double x2, double x1) {
-                auto t1 = x1 * x1  - x2;
-                auto t2 = x1 - 1.0;
-                return 100.0 * t1 * t1 + t2 * t2;
-            }
-        );
-        return cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-5.0, 10.0); }
-    auto extremum ( unsigned i ) const -> double { return (i == 0 ? 0.0 : 1.0); }
-};
-
-class rastrigin : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        auto cost = std::accumulate(a, b, 0.0,
-            [](double sum, double x) {
-                static auto const TWOPI = 8.0 * std::atan(1.0);
-                return sum + x * x - 10.0 * std::cos(TWOPI * x);
-            }
-        );            
-        unsigned n = distance(a,b);
-        return 10.0 * n + cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-5.12, 5.12); }
-    auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
-
-class griewangk : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        auto cost1 = std::accumulate(a, b, 0.0,
-            [](double sum, double x) { return sum + x * x  / 4000.0; }
-        );
-        auto i = 0.0;
-        auto cost2 = std::accumulate(a, b, 1.0,
-            [&i](double prod, double x) {
-                return prod * std::cos(x / std::sqrt(++i));
-            }
-        );
-        return cost1 - cost2 + 1.0;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-600.0, 600.0); }
-    auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
-
-class shaffer_f6 : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        auto x1 = *(a++), x2 = *a;
-        auto h = x1 * x1 + x2 * x2;
-        auto denom = 1 + 0.001 * h;
-        auto numer = std::sin(std::sqrt(h));  
-        auto cost = 0.5 + (numer * numer - 0.5) / (denom * denom);
-        return cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); } //!!
-    auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
-
-class shaffer_f6_inv : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        auto x1 = *(a++), x2 = *a;
-        auto h = x1 * x1 + x2 * x2;
-        auto denom = 1 + 0.001 * h;
-        auto numer = std::sin(std::sqrt(h));  
-        auto cost = 0.5 - (numer * numer - 0.5) / (denom * denom);
-        return cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); } //!!
-    auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
-
-class beale : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        if (std::distance(a, b) != 2)
-            { throw std::logic_error("must have exactly 2 dimensions"); }
-        auto& x1 = *(a++);
-        auto& x2 = *a;
-        auto t1 = 1.5 - x1 * (1 - x2);
-        auto t2 = 2.25 - x1 * (1 - x2 * x2);
-        auto t3 = 2.625 - x1 * (1-x2*x2*x2);
-        double cost = t1 * t1 + t2 * t2 + t3 * t3;
-        return cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-4.5, 4.5); }
-    auto extremum ( unsigned i ) const -> double
-        { return (i == 0 ? 0.0 : (i == 1 ? 3.0 : 0.5)); }
-};
-
-/*
-class bohachevsky1
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        if (std::distance(a, b) != 2)
-            { throw std::logic_error("must have exactly 2 dimensions"); }
-        auto& x1 = *(a++);
-        auto& x2 = *a;
-        auto t1 = x1 * x1;
-        auto t2 = 2 * x2 * x2;
-        auto t3 = 0.3 * std::cos( THREE_PI * x1 + FOUR_PI * x2 );
-        double cost = t1 * t1 + t2 * t2 + t3 * t3;
-        return cost;
-    }
-    //auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-600.0, 600.0); }
-    //auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
-*/
-
-class booth : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        if (std::distance(a, b) != 2)
-            { throw std::logic_error("must have exactly 2 dimensions"); }
-        auto& x1 = *(a++);
-        auto& x2 = *a;
-        auto t1 = x1 + 2 * x2 - 7;
-        auto t2 = 2 * x1 + x2 - 5;
-        double cost = t1 * t1 + t2 * t2;
-        return cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); }
-    auto extremum ( unsigned i ) const -> double
-        { return (i == 0 ? 0.0 : (i == 1 ? 1.0 : 3.0)); }
-};
-
-class branin : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        if (std::distance(a, b) != 2)
-            { throw std::logic_error("must have exactly 2 dimensions"); }
-        auto& x1 = *(a++);
-        auto& x2 = *a;
-        auto t1 = 1.5 - x1 * (1 - x2);
-        auto t2 = 2.25 - x1 * (1 - x2 * x2);
-        auto t3 = 2.625 - x1 * (1-x2*x2*x2);
-        double cost = t1 * t1 + t2 * t2 + t3 * t3;
-        return cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type
-        { return (i == 1 ? std::make_pair(-5.0, 10.0) : std::make_pair(-0.0, 15.0)); }
-    auto extremum ( unsigned i ) const -> double
-        { return (i == 0 ? 0.397887 : (i == 1 ? 9.42478 : 2.475)); }
-};
-
-class colville : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        if (std::distance(a, b) != 4)
-            { throw std::logic_error("must have exactly 4 dimensions"); }
-        auto& x1 = *(a++);
-        auto& x2 = *(a++);
-        auto& x3 = *(a++);
-        auto& x4 = *a;
-        auto t1 = x1 * x1 - x2;
-        auto t2 = x1 - 1;
-        auto t3 = x3 - 1;
-        auto t4 = x3 * x3 - x4;
-        auto t5 = x4 - 1;
-        auto t6 = x2 - 1;
-        double cost = 100.0 * t1 * t1 + t2 * t2 + t3 * t3 + 90.0 * t4 * t4
-            + 10.1 * (t3 * t3 + t5 * t5) + 19.8 * t6 * t5;
-        return cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); }
-    auto extremum ( unsigned i ) const -> double { return (i == 0 ? 0.0 : 1.0); }
-};
-
-class dixon_price : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
-    {
-        auto cost = *a - 1.0;
-        cost *= cost;
+    profile(s);
+    auto best = s.best_solution();
+    std::cout << best.first << std::endl;
+    std::copy(best.second.cbegin(), best.second.cend(), std::ostream_iterator<double>(std::cout," "));
+    std::cout << std::endl;
+    return 0;
+}
 
-        unsigned i = 1;
-        cost += std::inner_product(a+1, b, a, 0.0,
-            std::plus<double>(),
-            [&i](double x2, double x1) {
-                auto t = 2 * x2 * x2 - x1;
-                return (++i) * t * t;
-            }
-        );
-        return cost;
-    }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); }
-    auto extremum ( unsigned i ) const -> double { return 0.0; }
+/* What to run besides the function and its dimensions */
+struct options
+{
+    topology_param t;
+    /* trajectory file, if any */
+    std::string path;
+    /* checkpoint file and seconds between checkpoints, if any */
+    std::string checkpoint;
+    double every;
+    /* take up the run saved in the checkpoint file */
+    bool resume;
+    /* evaluation cache file, if any, and the objective it is made for */
+    std::string cache;
+    std::string function;
+    /* give up evaluations that cannot beat the particle's best */
+    bool bounded;
 };
 
-class swarm : std::vector<particle>
-{
-    using super = std::vector<particle>;
-public:
-    struct param_type
-    {
-        /* Population size */
-        double n;
-        /* Cognitive trust parameter */
-        double c1;
-        /* Social trust parameter */
-        double c2;
-        /* Current inertia */
-        double w;
-        /* Initial inertia */
-        double w0;
-        /* Inertial decay */
-        double wd;
-        /* Velocity fraction */
-        double k;
-        /* Velocity decay */
-        double vd;
-        /* Decay delay in iterations */
-        long d;
-    };
-
-    explicit swarm ( int d, objective* f = new sphere(),
-                      param_type p = {20,2.0,2.0,1.0,1.0,0.95,0.5,0.95,200} )
-        : super(p.n, d), param(p), f(f), leader(begin()),
-          vmax(d, 0.0), rng(std::random_device()())
-    {
-        auto i = 0L;
-        std::generate(vmax.begin(), vmax.end(), [&i,this](){
-            auto bounds = this->f->domain(i++);
-            auto range = bounds.second - bounds.first;
-            return range * param.k;
-        });
-    }
-
-    particle::solution best_solution() { return leader->local_best; }
-
-    void operator() ()
-    {
-        std::cerr << param.n << ' '
-                  << param.c1 << ' '
-                  << param.c2 << ' '
-                  << param.w << ' '
-                  << param.w0 << ' '
-                  << param.wd << ' '
-                  << param.k << ' '
-                  << param.vd << ' '
-                  << param.d << std::endl;
-        initialize();
-
-        auto k = 0LL, t = 0LL;
-        do {
-            for ( auto i = begin(); i != end(); ++i, ++k ) {
-                if ( update(i) ) {
-                    t = 0;
-                } else {
-                    ++t;
-                }
-                if (t == param.d) {
-                    t = 0;
-                    param.w  *= param.wd;
-                    for ( auto& vm : vmax ) {
-                        vm *= param.vd;
-                    }
-                }
-
-                if (leader->local_best.first < 0.1 || k > 640000) {
-                    std::cerr << k << std::endl;
-                    return;
-                }
-            }
-        } while (true);
-    }
-
-private:
-    bool update ( iterator i )
-    {
-        // compute velocity
-        {
-            auto xi = i->cbegin();
-            auto vm = vmax.cbegin();
-            auto p = i->local_best.second.cbegin();
-            auto g = leader->local_best.second.cbegin();
-            std::transform(i->velocity.cbegin(), i->velocity.cend(),
-                           i->velocity.begin(),
-                           [&,this](double vprev){
-                auto r1 = std::generate_canonical<double,16>(rng);
-                auto r2 = std::generate_canonical<double,16>(rng);
-                auto x = *xi++;
-                auto vmax = *vm++;
-                auto v = vprev * param.w
-                    + r1 * param.c1 * (*p++ - x)
-                    + r2 * param.c2 * (*g++ - x);
-                return std::max( std::min( v, vmax ), -vmax );
+/** Run f in d dimensions, on a fixed-size engine when d is a common size,
+ *  the swarm is global-best and there is nothing to record, save, resume,
+ *  cache or bound. */
+template <typename F>
+int run ( F* f, int d, options const& o )
+{
+    auto const& t = o.t;
+    auto const& path = o.path;
+    if (t.kind != topology_param::shape::global || !path.empty() || !o.checkpoint.empty()
+            || !o.cache.empty() || o.bounded) {
+        auto memo = o.cache.empty() ? nullptr : new cached_objective(f, o.function, o.cache, d);
+        swarm s { d, memo ? memo : static_cast<objective*>(f) };
+        s.connect(t);
+        s.abandon(o.bounded);
+        std::unique_ptr<recorder> tape;
+        if (!path.empty()) {
+            tape.reset(new recorder(path, s.size(), s.dimensions()));
+            s.record_to(tape.get());
+        }
+        if (o.resume) { s.resume(checkpoint::file(o.checkpoint).contents()); }
+        std::unique_ptr<checkpoint::writer> saver;
+        if (!o.checkpoint.empty() && o.every > 0) {
+            saver.reset(new checkpoint::writer(o.checkpoint));
+            auto w = saver.get();
+            s.every(int(o.every * 1000), [w](swarm const& s) {
+                checkpoint::image img;
+                s.save(img);
+                w->submit(std::move(img));
             });
         }
-
-        // update position
-        std::transform(i->cbegin(), i->cend(), i->velocity.cbegin(),
-                       i->begin(), std::plus<double>());
-        // compute cost
-        auto cost = (*f)(i->begin(), i->end());
-        // update personal best
-        if ( cost < i->local_best ) {
-            i->local_best.second.assign(i->cbegin(),i->cend());
-            i->local_best.first = cost;
-            // update global best
-            if ( cost < leader->local_best ) {
-                leader = i;
-            }
-            if (leader == i) { return true; }
+        s();
+        if (tape) {
+            tape->close();
+            std::cerr << tape->frames() << " frames recorded" << std::endl;
         }
-        return false;
-    }
-
-    void initialize()
-    {
-        randomize();
-        for ( auto i = begin(); i != end(); ++i) {
-            // compute cost
-            auto cost = (*f)(i->begin(), i->end());
-            // update personal best
-            i->local_best.second.assign(i->cbegin(),i->cend());
-            i->local_best.first = cost;
-            if (cost < leader->local_best) {
-                leader = i;
-            }
+        if (memo) {
+            auto st = memo->stats();
+            std::cerr << st.hits << " hits, " << st.misses << " misses, "
+                      << st.evictions << " evictions" << std::endl;
         }
+        return report(s);
     }
-
-    void randomize()
-    {
-        std::uniform_real_distribution<> dis;
-        for ( auto& p : *this )
-        {
-            auto i = 0U;
-            std::generate(p.begin(), p.end(), [&i,&dis,this](){
-                dis.param(std::uniform_real_distribution<>::param_type(
-                    f->domain(i).first, f->domain(i).second
-                ));
-                ++i;
-                return dis(rng);
-            });
-        }
-        for ( auto& p : *this )
-        {
-            auto vm = vmax.cbegin();
-            std::generate(p.velocity.begin(), p.velocity.end(), [&,this](){
-                dis.param(std::uniform_real_distribution<>::param_type( -*vm, *vm ));
-                ++vm;
-                return dis(rng);
-            });
-        }
+    switch (d) {
+    case 2: { fixed::swarm<2,double,F> s { f }; s(); return report(s); }
+    case 3: { fixed::swarm<3,double,F> s { f }; s(); return report(s); }
+    case 4: { fixed::swarm<4,double,F> s { f }; s(); return report(s); }
+    case 8: { fixed::swarm<8,double,F> s { f }; s(); return report(s); }
+    default: { swarm s { d, f }; s(); return report(s); }
     }
+}
 
-    param_type param;
-    std::unique_ptr<objective> f;
-    super::iterator leader;
-    std::vector<double> vmax;
-    std::mt19937 rng;
-};
+int usage ( char const* self )
+{
+    std::cerr << "usage: " << self << " [-c checkpoint [-e seconds]] [-r] [-m cache] [-b]"
+              << " [function [dimensions [topology [rewire [trajectory]]]]]" << std::endl
+              << "topology: global ring von_neumann star regular small_world scale_free" << std::endl
+              << "-c saves the run every 60 seconds (or -e), -r resumes it from the checkpoint" << std::endl
+              << "-m remembers evaluations in the cache file, across runs" << std::endl
+              << "-b stops evaluating a particle once it cannot beat its best" << std::endl;
+    return 1;
+}
 
 int main (int argc, char** argv)
 {
-    /*
-    int const N = atoi(argv[1]);
-    double w0, c1, c2;
-    std::istringstream arg(argv[2]);
-    arg >> w0;
-    arg.str(argv[3]);
-    arg >> c1;
-    arg.str(argv[4]);
-    arg >> c2;
-    */
-
-    swarm s { 64, new griewangk() };
-    s();
-
-    //double bestcost = s.best_solution().first;
-    //auto const& best = s.best_solution().second;
-    //std::cout << bestcost << std::endl;
-    //std::copy(best.cbegin(), best.cend(), std::ostream_iterator<double>(std::cout," "));
-    //std::cout << std::endl;
-
-    return 0;
+    auto const self = argv[0];
+    options o { topology_param(), "", "", 60.0, false, "", "", false };
+    while (argc > 1 && argv[1][0] == '-') {
+        if (std::string(argv[1]) == "-c" && argc > 2) { o.checkpoint = argv[2]; --argc; ++argv; }
+        else if (std::string(argv[1]) == "-e" && argc > 2) { o.every = atof(argv[2]); --argc; ++argv; }
+        else if (std::string(argv[1]) == "-r") { o.resume = true; }
+        else if (std::string(argv[1]) == "-m" && argc > 2) { o.cache = argv[2]; --argc; ++argv; }
+        else if (std::string(argv[1]) == "-b") { o.bounded = true; }
+        else { return usage(self); }
+        --argc;
+        ++argv;
+    }
+    if (o.resume && o.checkpoint.empty()) { return usage(self); }
+
+    std::string const name = argc > 1 ? argv[1] : "griewangk";
+    int const d = argc > 2 ? atoi(argv[2]) : 64;
+    // ring/small_world link 2 each side, regular has degree 4, scale_free adds 2 links
+    o.t = topology_param { topology_param::shape::global, 2, 0.1, argc > 4 ? atol(argv[4]) : 0 };
+    if (argc > 3 && !topology_param::parse(argv[3], o.t.kind)) { return usage(self); }
+    if (o.t.kind == topology_param::shape::regular) { o.t.k = 4; }
+    o.path = argc > 5 ? argv[5] : "";
+    o.function = name;
+
+    if (name == "sphere") { return run(new sphere(), d, o); }
+    if (name == "rosenbrock") { return run(new rosenbrock(), d, o); }
+    if (name == "rastrigin") { return run(new rastrigin(), d, o); }
+    if (name == "griewangk") { return run(new griewangk(), d, o); }
+    if (name == "ackley") { return run(new ackley(), d, o); }
+    if (name == "dixon_price") { return run(new dixon_price(), d, o); }
+    if (name == "shaffer_f6") { return run(new shaffer_f6(), 2, o); }
+    if (name == "beale") { return run(new beale(), 2, o); }
+    if (name == "booth") { return run(new booth(), 2, o); }
+    if (name == "branin") { return run(new branin(), 2, o); }
+    if (name == "colville") { return run(new colville(), 4, o); }
+
+    return usage(self);
 }
@@ -1,254 +1,366 @@
-//#include "objective.hpp"
-#include "runnables.hpp"
+#ifndef HPP_PSO
+#define HPP_PSO
+
+#include "checkpoint.hpp"
+#include "cppscript.hpp"
+#include "kernel.hpp"
+#include "objective.hpp"
+#include "params.hpp"
+#include "philox.hpp"
+#include "population.hpp"
+#include "probe.hpp"
+#include "recorder.hpp"
+#include "stop.hpp"
+#include "topology.hpp"
 #include <algorithm>
-#include <forward_list>
-#include <iomanip>
+#include <functional>
 #include <iostream>
-#include <iterator>
 #include <memory>
-#include <mutex>
 #include <numeric>
 #include <random>
-#include <sstream>
-#include <system_error>
+#include <utility>
 #include <vector>
 
-struct objective
+/** Synchronous swarm over a structure-of-arrays population. By default
+ *  every particle follows the global best; connect() gives it a
+ *  neighbourhood graph instead, and each particle then follows the best
+ *  personal best among itself and its neighbours. */
+class swarm
 {
-    using param = std::forward_list<double>::const_iterator;
-    using domain_type = std::pair<double,double>;
+public:
+    using solution = std::pair<double,std::vector<double>>;
+    using param_type = pso_param;
 
-    virtual auto operator() ( param a, param b ) const -> double = 0;
-    virtual auto domain ( unsigned i ) const -> domain_type = 0;
-    virtual auto extremum ( unsigned i ) const -> double = 0;
-};
+    explicit swarm ( int d, objective* f = new sphere(),
+                      param_type p = {20,2.0,2.0,1.0,1.0,0.95,0.5,0.95,200},
+                      std::uint64_t seed = std::random_device()() )
+        : param(p), f(f), pop(p.n, d), leader(0), sweep(0), k(0), t(0),
+          shape{topology_param::shape::global, 1, 0.0, 0},
+          poll(stop_token(), CHECK), tape(nullptr), bounded(false), resumed(false), r1(d), r2(d), rng(seed)
+    {
+        auto i = 0L;
+        std::generate(pop.vmax.begin(), pop.vmax.begin() + d, [&i,this](){
+            auto bounds = this->f->domain(i++);
+            auto range = bounds.second - bounds.first;
+            return range * param.k;
+        });
+    }
 
-class sphere : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
+    solution best_solution() const
     {
-        auto cost = std::inner_product(a, b, a, 0.0);
-        return cost;
+        auto g = pop.best.row(leader);
+        return solution(pop.best_cost[leader],
+                        std::vector<double>(g, g + pop.dimensions()));
     }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-5.12, 5.12); }
-    auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
 
-class rosenbrock : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
+    void operator() ()
     {
-        auto c = a;
-        auto cost = std::inner_product(++a, b, a, 0.0,
-            std::plus<double>(),
-            [](double x2, double x1) {
-                auto t1 = x1 * x1  - x2;
-                auto t2 = x1 - 1.0;
-                return 100.0 * t1 * t1 + t2 * t2;
-            }
-        );
-        return cost;
+        std::cerr << param.n << ' '
+                  << param.c1 << ' '
+                  << param.c2 << ' '
+                  << param.w << ' '
+                  << param.w0 << ' '
+                  << param.wd << ' '
+                  << param.k << ' '
+                  << param.vd << ' '
+                  << param.d << std::endl;
+        if (!resumed) { initialize(); }
+        resumed = false;
+        while (step()) {}
+        std::cerr << k << std::endl;
     }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-5.0, 10.0); }
-    auto extremum ( unsigned i ) const -> double { return (i == 0 ? 0.0 : 1.0); }
-};
 
-class rastrigin : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
+    /** Stop once t expires as well as on the target and the budget. The
+     *  token is looked at every CHECK updates; share one between swarms
+     *  to stop them together. */
+    void stop_on ( stop_token t ) { poll = stop_poll(std::move(t), CHECK); }
+    auto stop() const -> stop_token const& { return poll.token(); }
+
+    /** Call hook(*this) between sweeps about every `millis` ms, for
+     *  progress snapshots or checkpoints. The timer wheel only raises a
+     *  flag; the hook itself runs on the swarm's own thread, where the
+     *  state is consistent. */
+    void every ( int millis, std::function<void(swarm const&)> hook )
     {
-        auto cost = std::accumulate(a, b, 0.0,
-            [](double sum, double x) {
-                static auto const TWOPI = 8.0 * std::atan(1.0);
-                return sum + x * x - 10.0 * std::cos(TWOPI * x);
-            }
-        );            
-        unsigned n = distance(a,b);
-        return 10.0 * n + cost;
+        hooks.emplace_back(std::unique_ptr<cppscript::trigger>(new cppscript::trigger(millis)),
+                           std::move(hook));
     }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-5.12, 5.12); }
-    auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
 
-class griewangk : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
+    /** Append a snapshot to r after initialize() and after every sweep;
+     *  r must outlive the run. */
+    void record_to ( recorder* r ) { tape = r; }
+
+    /** Let update() give up on a candidate once it cannot beat its
+     *  personal best (see objective::bounded); such a candidate's cost is
+     *  then only a lower bound. Off by default, and ignored while a tape
+     *  records, since frames carry every particle's exact cost. */
+    void abandon ( bool on ) { bounded = on; }
+
+    /** Everything the run depends on: the population, the leader, the
+     *  decayed w and vmax, the counters, the neighbourhood settings and the
+     *  seed. The random draws depend only on (seed, particle, sweep) and
+     *  the neighbourhood graph on (seed, round), so this is enough for a
+     *  resumed run to continue exactly as the original would have. Call
+     *  between sweeps, e.g. from an every() hook. */
+    void save ( checkpoint::image& img ) const
     {
-        auto cost1 = std::accumulate(a, b, 0.0,
-            [](double sum, double x) { return sum + x * x  / 4000.0; }
-        );
-        auto i = 0.0;
-        auto cost2 = std::accumulate(a, b, 1.0,
-            [&i](double prod, double x) {
-                return prod * std::cos(x / std::sqrt(++i));
-            }
-        );
-        return cost1 - cost2 + 1.0;
+        auto const n = pop.size(), d = pop.dimensions();
+        img.put(std::uint64_t(n));
+        img.put(std::uint64_t(d));
+        img.put(param);
+        img.put(std::int32_t(shape.kind));
+        img.put(std::uint64_t(shape.k));
+        img.put(shape.p);
+        img.put(std::int64_t(shape.rewire));
+        img.put(rng.seed());
+        img.put(std::uint64_t(leader));
+        img.put(sweep);
+        img.put(k);
+        img.put(t);
+        for ( auto const* m : { &pop.position, &pop.velocity, &pop.best } )
+            { for ( std::size_t i = 0; i < n; ++i ) { img.put(m->row(i), d * sizeof(double)); } }
+        img.put(pop.cost.data(), n * sizeof(double));
+        img.put(pop.best_cost.data(), n * sizeof(double));
+        img.put(pop.vmax.data(), d * sizeof(double));
     }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-600.0, 600.0); }
-    auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
 
-class shaffer_f6 : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
+    /** Take up a saved run instead of starting afresh: operator() then
+     *  goes straight on with the next sweep. The swarm must have the same
+     *  size and dimensions, and the same objective, as the saved one. */
+    void resume ( checkpoint::view in )
     {
-        auto x1 = *(a++), x2 = *a;
-        auto h = x1 * x1 + x2 * x2;
-        auto denom = 1 + 0.001 * h;
-        auto numer = std::sin(std::sqrt(h));  
-        auto cost = 0.5 + (numer * numer - 0.5) / (denom * denom);
-        return cost;
+        auto const n = pop.size(), d = pop.dimensions();
+        if (in.get<std::uint64_t>() != n || in.get<std::uint64_t>() != d)
+            { throw checkpoint::invalid("saved swarm has another shape"); }
+        param = in.get<param_type>();
+        shape.kind = topology_param::shape(in.get<std::int32_t>());
+        shape.k = std::size_t(in.get<std::uint64_t>());
+        shape.p = in.get<double>();
+        shape.rewire = long(in.get<std::int64_t>());
+        rng = philox(in.get<std::uint64_t>());
+        leader = std::size_t(in.get<std::uint64_t>());
+        sweep = in.get<long long>();
+        k = in.get<long long>();
+        t = in.get<long long>();
+        for ( auto* m : { &pop.position, &pop.velocity, &pop.best } )
+            { for ( std::size_t i = 0; i < n; ++i ) { in.get(m->row(i), d * sizeof(double)); } }
+        in.get(pop.cost.data(), n * sizeof(double));
+        in.get(pop.best_cost.data(), n * sizeof(double));
+        in.get(pop.vmax.data(), d * sizeof(double));
+        links = topology::make(shape, n, rng, shape.rewire > 0 ? sweep / shape.rewire : 0);
+        resumed = true;
     }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); } //!!
-    auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
 
-class shaffer_f6_inv : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
+    /** Use the neighbourhood t from the next initialize() on. */
+    void connect ( topology_param t ) { shape = t; }
+
+    auto neighbourhood() const -> graph const& { return links; }
+
+    /** One sweep over the particles. Returns false once the target cost
+     *  or the evaluation budget is reached or the stop token expires
+     *  (possibly mid-sweep). Call initialize() first. */
+    bool step()
     {
-        auto x1 = *(a++), x2 = *a;
-        auto h = x1 * x1 + x2 * x2;
-        auto denom = 1 + 0.001 * h;
-        auto numer = std::sin(std::sqrt(h));  
-        auto cost = 0.5 - (numer * numer - 0.5) / (denom * denom);
-        return cost;
+        for ( auto& h : hooks ) { if (h.first->consume()) { h.second(*this); } }
+        ++sweep;
+        if (shape.rewire > 0 && sweep % shape.rewire == 0)
+            { links = topology::make(shape, pop.size(), rng, sweep / shape.rewire); }
+        for ( auto i = 0UL; i < pop.size(); ++i, ++k ) {
+            if ( update(i) ) {
+                t = 0;
+            } else {
+                ++t;
+            }
+            if (t == param.d) {
+                t = 0;
+                probes.count(probe::decays);
+                param.w  *= param.wd;
+                for ( auto& vm : pop.vmax ) {
+                    vm *= param.vd;
+                }
+            }
+
+            if (pop.best_cost[leader] < 0.1 || k > 640000 || poll()) {
+                capture();
+                return false;
+            }
+        }
+        capture();
+        return true;
     }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); } //!!
-    auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
 
-class beale : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
+    void initialize()
     {
-        if (std::distance(a, b) != 2)
-            { throw std::logic_error("must have exactly 2 dimensions"); }
-        auto& x1 = *(a++);
-        auto& x2 = *a;
-        auto t1 = 1.5 - x1 * (1 - x2);
-        auto t2 = 2.25 - x1 * (1 - x2 * x2);
-        auto t3 = 2.625 - x1 * (1-x2*x2*x2);
-        double cost = t1 * t1 + t2 * t2 + t3 * t3;
-        return cost;
+        links = topology::make(shape, pop.size(), rng, 0);
+        randomize();
+        auto const n = pop.dimensions();
+        // compute cost
+        f->evaluate(pop.position.data(), pop.size(), n, pop.position.pitch(),
+                    pop.cost.data());
+        for ( auto i = 0UL; i < pop.size(); ++i ) {
+            auto cost = pop.cost[i];
+            // update personal best
+            std::copy(pop.position.row(i), pop.position.row(i) + n, pop.best.row(i));
+            pop.best_cost[i] = cost;
+            if (cost < pop.best_cost[leader] || i == 0) {
+                leader = i;
+            }
+        }
+        capture();
     }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-4.5, 4.5); }
-    auto extremum ( unsigned i ) const -> double
-        { return (i == 0 ? 0.0 : (i == 1 ? 3.0 : 0.5)); }
-};
 
-/*
-class bohachevsky1
-{
-public:
-    auto operator() ( param a, param b ) const -> double
+    /** Indices of the m particles with the best personal bests, best first. */
+    auto ranking ( std::size_t m ) const -> std::vector<std::size_t>
     {
-        if (std::distance(a, b) != 2)
-            { throw std::logic_error("must have exactly 2 dimensions"); }
-        auto& x1 = *(a++);
-        auto& x2 = *a;
-        auto t1 = x1 * x1;
-        auto t2 = 2 * x2 * x2;
-        auto t3 = 0.3 * std::cos( THREE_PI * x1 + FOUR_PI * x2 );
-        double cost = t1 * t1 + t2 * t2 + t3 * t3;
-        return cost;
+        std::vector<std::size_t> order(pop.size());
+        std::iota(order.begin(), order.end(), 0);
+        m = std::min(m, order.size());
+        std::partial_sort(order.begin(), order.begin() + m, order.end(),
+            [this](std::size_t a, std::size_t b) { return pop.best_cost[a] < pop.best_cost[b]; });
+        order.resize(m);
+        return order;
     }
-    //auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-600.0, 600.0); }
-    //auto extremum ( unsigned i ) const -> double { return 0.0; }
-};
-*/
 
-class booth : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
+    /** Personal bests of the m best particles, best first. */
+    auto emigrants ( std::size_t m ) const -> std::vector<solution>
     {
-        if (std::distance(a, b) != 2)
-            { throw std::logic_error("must have exactly 2 dimensions"); }
-        auto& x1 = *(a++);
-        auto& x2 = *a;
-        auto t1 = x1 + 2 * x2 - 7;
-        auto t2 = 2 * x1 + x2 - 5;
-        double cost = t1 * t1 + t2 * t2;
-        return cost;
+        std::vector<solution> out;
+        for ( auto i : ranking(m) ) {
+            auto b = pop.best.row(i);
+            out.emplace_back(pop.best_cost[i], std::vector<double>(b, b + pop.dimensions()));
+        }
+        return out;
     }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); }
-    auto extremum ( unsigned i ) const -> double
-        { return (i == 0 ? 0.0 : (i == 1 ? 1.0 : 3.0)); }
-};
 
-class branin : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
+    /** Overwrite particle i with a migrant: it becomes both the current
+     *  position and the personal best, and the leader if it beats it. The
+     *  particle keeps its velocity. */
+    void immigrate ( std::size_t i, double cost, double const* x )
     {
-        if (std::distance(a, b) != 2)
-            { throw std::logic_error("must have exactly 2 dimensions"); }
-        auto& x1 = *(a++);
-        auto& x2 = *a;
-        auto t1 = 1.5 - x1 * (1 - x2);
-        auto t2 = 2.25 - x1 * (1 - x2 * x2);
-        auto t3 = 2.625 - x1 * (1-x2*x2*x2);
-        double cost = t1 * t1 + t2 * t2 + t3 * t3;
-        return cost;
+        auto const n = pop.dimensions();
+        std::copy(x, x + n, pop.position.row(i));
+        std::copy(x, x + n, pop.best.row(i));
+        pop.cost[i] = cost;
+        pop.best_cost[i] = cost;
+        if (cost < pop.best_cost[leader]) {
+            leader = i;
+        } else if (leader == i) {
+            leader = std::min_element(pop.best_cost.begin(), pop.best_cost.end())
+                   - pop.best_cost.begin();
+        }
     }
-    auto domain ( unsigned i ) const -> domain_type
-        { return (i == 1 ? std::make_pair(-5.0, 10.0) : std::make_pair(-0.0, 15.0)); }
-    auto extremum ( unsigned i ) const -> double
-        { return (i == 0 ? 0.397887 : (i == 1 ? 9.42478 : 2.475)); }
-};
 
-class colville : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
+    auto size() const -> std::size_t { return pop.size(); }
+    auto dimensions() const -> std::size_t { return pop.dimensions(); }
+    auto evaluations() const -> long long { return k; }
+    /** Personal best cost and position of particle i. */
+    auto cost ( std::size_t i ) const -> double { return pop.best_cost[i]; }
+    auto best ( std::size_t i ) const -> double const* { return pop.best.row(i); }
+    /** Current position and velocity of particle i. */
+    auto position ( std::size_t i ) const -> double const* { return pop.position.row(i); }
+    auto velocity ( std::size_t i ) const -> double const* { return pop.velocity.row(i); }
+    auto leading() const -> std::size_t { return leader; }
+    /** Instrumentation of this swarm's thread (see probe.hpp). */
+    auto instruments() const -> probe::sheet const& { return probes; }
+
+private:
+    /* updates between looks at the stop token */
+    static unsigned const CHECK = 64;
+
+    void capture() { if (tape) { tape->record(sweep, k, pop); } }
+
+    /* particle i follows: the leader, or its best neighbour */
+    auto social ( std::size_t i ) const -> std::size_t
     {
-        if (std::distance(a, b) != 4)
-            { throw std::logic_error("must have exactly 4 dimensions"); }
-        auto& x1 = *(a++);
-        auto& x2 = *(a++);
-        auto& x3 = *(a++);
-        auto& x4 = *a;
-        auto t1 = x1 * x1 - x2;
-        auto t2 = x1 - 1;
-        auto t3 = x3 - 1;
-        auto t4 = x3 * x3 - x4;
-        auto t5 = x4 - 1;
-        auto t6 = x2 - 1;
-        double cost = 100.0 * t1 * t1 + t2 * t2 + t3 * t3 + 90.0 * t4 * t4
-            + 10.1 * (t3 * t3 + t5 * t5) + 19.8 * t6 * t5;
-        return cost;
+        if (links.size() == 0) { return leader; }
+        auto s = i;
+        for ( auto j = links.begin(i); j != links.end(i); ++j )
+            { if (pop.best_cost[*j] < pop.best_cost[s]) { s = *j; } }
+        return s;
     }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); }
-    auto extremum ( unsigned i ) const -> double { return (i == 0 ? 0.0 : 1.0); }
-};
 
-class dixon_price : public objective
-{
-public:
-    auto operator() ( param a, param b ) const -> double
+    bool update ( std::size_t i )
+    {
+        auto const n = pop.dimensions();
+        auto x = pop.position.row(i);
+        auto v = pop.velocity.row(i);
+        probe::stopwatch clock(probes);
+
+        // draw this particle's coefficients for the current sweep
+        rng.fill(i, sweep, philox::COGNITIVE, r1.data(), n);
+        rng.fill(i, sweep, philox::SOCIAL, r2.data(), n);
+
+        // compute velocity and update position
+        kernel::update()(x, v, pop.best.row(i), pop.best.row(social(i)),
+                         pop.vmax.data(), r1.data(), r2.data(),
+                         param.w, param.c1, param.c2, n);
+        // the kernel fuses the two, so the position phase stays empty here
+        clock.lap(probe::velocity);
+        // compute cost, giving up once it cannot beat the personal best
+        // if allowed to; a candidate given up on keeps a lower bound
+        auto cost = bounded && !tape ? f->bounded(x, x + n, pop.best_cost[i]) : (*f)(x, x + n);
+        probes.count(probe::evaluations);
+        clock.lap(probe::evaluation);
+        pop.cost[i] = cost;
+        // update personal best
+        auto leads = false;
+        if ( cost < pop.best_cost[i] ) {
+            probes.count(probe::improvements);
+            std::copy(x, x + n, pop.best.row(i));
+            pop.best_cost[i] = cost;
+            // update global best
+            if ( cost < pop.best_cost[leader] ) {
+                if (leader != i) { probes.count(probe::leader_changes); }
+                leader = i;
+            }
+            leads = leader == i;
+        }
+        clock.lap(probe::best);
+        return leads;
+    }
+
+    void randomize()
     {
-        auto cost = *a - 1.0;
-        cost *= cost;
-
-        unsigned i = 1;
-        cost += std::inner_product(a+1, b, a, 0.0,
-            std::plus<double>(),
-            [&i](double x2, double x1) {
-                auto t = 2 * x2 * x2 - x1;
-                return (++i) * t * t;
+        auto const n = pop.dimensions();
+        for ( auto i = 0UL; i < pop.size(); ++i )
+        {
+            auto x = pop.position.row(i);
+            rng.fill(i, 0, philox::POSITION, x, n);
+            for ( auto j = 0U; j < n; ++j ) {
+                auto bounds = f->domain(j);
+                x[j] = bounds.first + x[j] * (bounds.second - bounds.first);
+            }
+        }
+        for ( auto i = 0UL; i < pop.size(); ++i )
+        {
+            auto v = pop.velocity.row(i);
+            rng.fill(i, 0, philox::VELOCITY, v, n);
+            for ( auto j = 0U; j < n; ++j ) {
+                auto vm = pop.vmax[j];
+                v[j] = -vm + v[j] * (vm + vm);
             }
-        );
-        return cost;
+        }
     }
-    auto domain ( unsigned i ) const -> domain_type { return std::make_pair(-10.0, 10.0); }
-    auto extremum ( unsigned i ) const -> double { return 0.0; }
+
+    param_type param;
+    std::unique_ptr<objective> f;
+    population pop;
+    std::size_t leader;
+    long long sweep;
+    long long k;
+    long long t;
+    topology_param shape;
+    graph links;
+    stop_poll poll;
+    probe::sheet probes;
+    recorder* tape;
+    bool bounded;
+    bool resumed;
+    std::vector<std::pair<std::unique_ptr<cppscript::trigger>,
+                          std::function<void(swarm const&)>>> hooks;
+    aligned_vector<double> r1;
+    aligned_vector<double> r2;
+    philox rng;
 };
+
+#endif
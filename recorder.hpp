@@ -0,0 +1,296 @@
+#ifndef HPP_RECORDER
+#define HPP_RECORDER
+
+#include "population.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Trajectory file: a 64-byte header, then one fixed-size frame per
+ *  recorded sweep, so frame i sits at a computed offset:
+ *
+ *      header  "PSOTRAJ1", version, particles n, dimensions d, frame bytes
+ *      frame   sweep, evaluations (int64), then n*d positions, n*d
+ *              velocities, n costs and n personal best costs (double)
+ *
+ *  Every particle moves every sweep, so a delta would be as large as a
+ *  snapshot; frames are always whole snapshots. Host byte order.
+ */
+namespace trajectory_format
+{
+    char const MAGIC[8] = { 'P', 'S', 'O', 'T', 'R', 'A', 'J', '1' };
+    std::uint32_t const VERSION = 1;
+    std::size_t const HEADER = 64;
+
+    struct header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t reserved;
+        std::uint64_t particles;
+        std::uint64_t dimensions;
+        std::uint64_t frame;
+        char padding[HEADER - 40];
+    };
+
+    inline auto frame_bytes ( std::size_t n, std::size_t d ) -> std::size_t
+        { return 2 * sizeof(std::int64_t) + (2 * n * d + 2 * n) * sizeof(double); }
+}
+
+/** Streams population snapshots to a trajectory file.
+ *
+ *  record() copies the population into one of two buffers and returns;
+ *  a writer thread writes the other buffer meanwhile, so the swarm only
+ *  pays for the copy unless the disk falls behind, in which case record()
+ *  waits for it. A buffer holds as many frames as fit in about a
+ *  megabyte, which keeps the writes large. Write errors surface from the
+ *  next record() or from close().
+ */
+class recorder
+{
+public:
+    recorder ( std::string const& path, std::size_t particles, std::size_t dimensions )
+        : n(particles), d(dimensions), bytes(trajectory_format::frame_bytes(n, d)),
+          per_buffer(std::max<std::size_t>(1, (1 << 20) / bytes)), filled(0), count(0),
+          writing(false), handed(0), error(0), stopping(false)
+    {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) { throw std::system_error(errno, std::generic_category(), path); }
+        trajectory_format::header h;
+        std::memset(&h, 0, sizeof(h));
+        std::memcpy(h.magic, trajectory_format::MAGIC, sizeof(h.magic));
+        h.version = trajectory_format::VERSION;
+        h.particles = n;
+        h.dimensions = d;
+        h.frame = bytes;
+        if (!put(reinterpret_cast<char const*>(&h), sizeof(h))) {
+            auto e = errno;
+            ::close(fd);
+            throw std::system_error(e, std::generic_category(), path);
+        }
+        for ( auto& b : buffer ) { b.resize(per_buffer * bytes); }
+        writer = std::thread(&recorder::serve, this);
+    }
+
+    recorder ( recorder const& ) = delete;
+    recorder& operator= ( recorder const& ) = delete;
+
+    ~recorder()
+    {
+        try { close(); } catch (...) {}
+    }
+
+    /** Append a snapshot of p taken after `sweep` sweeps and `evaluations`
+     *  evaluations. p must have the shape the recorder was opened with. */
+    void record ( long long sweep, long long evaluations, population const& p )
+    {
+        auto frame = buffer[current()].data() + filled * bytes;
+        std::int64_t counts[] = { sweep, evaluations };
+        std::memcpy(frame, counts, sizeof(counts));
+        auto out = reinterpret_cast<double*>(frame + sizeof(counts));
+        for ( std::size_t i = 0; i < n; ++i, out += d )
+            { std::memcpy(out, p.position.row(i), d * sizeof(double)); }
+        for ( std::size_t i = 0; i < n; ++i, out += d )
+            { std::memcpy(out, p.velocity.row(i), d * sizeof(double)); }
+        std::memcpy(out, p.cost.data(), n * sizeof(double));
+        std::memcpy(out + n, p.best_cost.data(), n * sizeof(double));
+        ++count;
+        if (++filled == per_buffer) { hand_off(); }
+    }
+
+    /** Frames recorded so far. */
+    auto frames() const -> long long { return count; }
+
+    /** Write out what is buffered and close the file. */
+    void close()
+    {
+        if (fd < 0) { return; }
+        if (filled) { hand_off(); }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            idle.wait(lock, [this]{ return !writing; });
+            stopping = true;
+        }
+        wake.notify_all();
+        writer.join();
+        auto e = error;
+        ::close(fd);
+        fd = -1;
+        if (e) { throw std::system_error(e, std::generic_category(), "trajectory"); }
+    }
+
+private:
+    /* the buffer record() fills: the one the writer is not on */
+    auto current() const -> std::size_t { return handed & 1; }
+
+    void hand_off()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this]{ return !writing; });
+        if (error) { throw std::system_error(error, std::generic_category(), "trajectory"); }
+        length = filled * bytes;
+        writing = true;
+        ++handed;
+        filled = 0;
+        lock.unlock();
+        wake.notify_one();
+    }
+
+    void serve()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this]{ return writing || stopping; });
+            if (!writing) { return; }
+            auto& b = buffer[(handed - 1) & 1];
+            auto size = length;
+            lock.unlock();
+            auto ok = put(b.data(), size);
+            auto e = errno;
+            lock.lock();
+            if (!ok) { error = e; }
+            writing = false;
+            idle.notify_all();
+        }
+    }
+
+    bool put ( char const* p, std::size_t size )
+    {
+        while (size > 0) {
+            auto w = ::write(fd, p, size);
+            if (w < 0 && errno == EINTR) { continue; }
+            if (w <= 0) { return false; }
+            p += w;
+            size -= std::size_t(w);
+        }
+        return true;
+    }
+
+    std::size_t const n;
+    std::size_t const d;
+    std::size_t const bytes;
+    std::size_t const per_buffer;
+    std::vector<char> buffer[2];
+    std::size_t filled;
+    long long count;
+    int fd;
+    // shared with the writer thread
+    bool writing;
+    std::uint64_t handed;
+    std::size_t length;
+    int error;
+    bool stopping;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::thread writer;
+};
+
+/** Read-only view of a trajectory file, mapped into memory: frames by
+ *  index or by sweep, particles within a frame, without reading the rest
+ *  of the file. A frame cut short at the end (a run that died) is left
+ *  out. */
+class trajectory
+{
+public:
+    class frame
+    {
+    public:
+        auto sweep() const -> long long { return counts()[0]; }
+        auto evaluations() const -> long long { return counts()[1]; }
+        auto position ( std::size_t i ) const -> double const* { return values() + i * d; }
+        auto velocity ( std::size_t i ) const -> double const* { return values() + (n + i) * d; }
+        auto cost ( std::size_t i ) const -> double { return values()[2 * n * d + i]; }
+        auto best_cost ( std::size_t i ) const -> double { return values()[2 * n * d + n + i]; }
+
+    private:
+        friend class trajectory;
+        frame ( char const* base, std::size_t n, std::size_t d ) : base(base), n(n), d(d) {}
+        auto counts() const -> std::int64_t const* { return reinterpret_cast<std::int64_t const*>(base); }
+        auto values() const -> double const*
+            { return reinterpret_cast<double const*>(base + 2 * sizeof(std::int64_t)); }
+        char const* base;
+        std::size_t n;
+        std::size_t d;
+    };
+
+    explicit trajectory ( std::string const& path )
+        : base(nullptr), length(0)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) { throw std::system_error(errno, std::generic_category(), path); }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            auto e = errno;
+            ::close(fd);
+            throw std::system_error(e, std::generic_category(), path);
+        }
+        length = std::size_t(st.st_size);
+        if (length < trajectory_format::HEADER) {
+            ::close(fd);
+            throw std::system_error(EINVAL, std::generic_category(), path + ": not a trajectory");
+        }
+        auto p = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) { throw std::system_error(errno, std::generic_category(), path); }
+        base = static_cast<char const*>(p);
+
+        auto const& h = *reinterpret_cast<trajectory_format::header const*>(base);
+        if (std::memcmp(h.magic, trajectory_format::MAGIC, sizeof(h.magic)) != 0
+                || h.version != trajectory_format::VERSION
+                || h.frame != trajectory_format::frame_bytes(h.particles, h.dimensions)) {
+            ::munmap(const_cast<char*>(base), length);
+            throw std::system_error(EINVAL, std::generic_category(), path + ": not a trajectory");
+        }
+        n = h.particles;
+        d = h.dimensions;
+        bytes = h.frame;
+        count = (length - trajectory_format::HEADER) / bytes;
+    }
+
+    trajectory ( trajectory const& ) = delete;
+    trajectory& operator= ( trajectory const& ) = delete;
+
+    ~trajectory() { ::munmap(const_cast<char*>(base), length); }
+
+    auto size() const -> std::size_t { return count; }
+    auto particles() const -> std::size_t { return n; }
+    auto dimensions() const -> std::size_t { return d; }
+
+    auto operator[] ( std::size_t i ) const -> frame
+        { return frame(base + trajectory_format::HEADER + i * bytes, n, d); }
+
+    /** Index of the first frame at or after `sweep`, or size(). */
+    auto find ( long long sweep ) const -> std::size_t
+    {
+        std::size_t lo = 0, hi = count;
+        while (lo < hi) {
+            auto mid = lo + (hi - lo) / 2;
+            if ((*this)[mid].sweep() < sweep) { lo = mid + 1; } else { hi = mid; }
+        }
+        return lo;
+    }
+
+private:
+    char const* base;
+    std::size_t length;
+    std::size_t n;
+    std::size_t d;
+    std::size_t bytes;
+    std::size_t count;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef HPP_REGISTRY
+#define HPP_REGISTRY
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+/** Flat, index-based swarm membership.
+ *
+ *  The registry owns every member and numbers them 0..size(). Next to
+ *  the members it keeps a table of their best costs and a single atomic
+ *  leader index, so a change of leadership is one compare-and-swap,
+ *  however large the swarm; followers read leader() when they need it
+ *  rather than being told. Members are added before the swarm starts
+ *  running and never move, so indices and references stay valid for the
+ *  life of the registry.
+ */
+template <typename Member>
+class registry
+{
+public:
+    registry() : current(0) {}
+    registry ( registry const& ) = delete;
+    registry& operator= ( registry const& ) = delete;
+
+    /** Construct Member(*this, index, args...) and keep it. */
+    template <typename... Args>
+    auto emplace ( Args&&... args ) -> Member&
+    {
+        std::lock_guard<std::mutex> lock(adding);
+        auto i = entries.size();
+        entries.emplace_back();
+        try {
+            entries.back().member.reset(new Member(*this, i, std::forward<Args>(args)...));
+        } catch (...) {
+            entries.pop_back();
+            throw;
+        }
+        return *entries.back().member;
+    }
+
+    auto size() const -> std::size_t { return entries.size(); }
+    auto operator[] ( std::size_t i ) -> Member& { return *entries[i].member; }
+    auto operator[] ( std::size_t i ) const -> Member const& { return *entries[i].member; }
+
+    auto leader() const -> std::size_t { return current.load(); }
+    /** Best cost member i has reported through lead(). */
+    auto cost ( std::size_t i ) const -> double { return entries[i].cost.load(); }
+
+    /** Member i's best is now c (costs only ever go down); it takes the
+     *  lead if that beats the current leader. True if i leads. */
+    bool lead ( std::size_t i, double c )
+    {
+        entries[i].cost.store(c);
+        return claim(i);
+    }
+
+private:
+    struct entry
+    {
+        entry() : cost(std::numeric_limits<double>::infinity()) {}
+        std::unique_ptr<Member> member;
+        std::atomic<double> cost;
+    };
+
+    bool claim ( std::size_t i )
+    {
+        auto c = entries[i].cost.load();
+        auto l = current.load();
+        while (l != i && c < entries[l].cost.load()) {
+            if (current.compare_exchange_weak(l, i)) {
+                // the member we displaced may have improved in the meantime
+                if (entries[l].cost.load() < c) { claim(l); }
+                return current.load() == i;
+            }
+        }
+        return l == i;
+    }
+
+    std::deque<entry> entries;
+    std::atomic<std::size_t> current;
+    std::mutex adding;
+};
+
+#endif
@@ -0,0 +1,428 @@
+#ifndef HPP_REMOTE
+#define HPP_REMOTE
+
+#include "islands.hpp"
+#include "net.hpp"
+#include "objective.hpp"
+#include "pso.hpp"
+#include "stop.hpp"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+
+/** Coordinator/worker protocol over TCP.
+ *
+ *  Every message is one frame: an 8-byte header (type, payload size)
+ *  followed by the payload, all in the host's byte order (the nodes are
+ *  assumed to share an architecture). A frame goes out in a single send.
+ *  A receiver refuses a frame larger than the setup allows for its type,
+ *  so a corrupt header can't make it allocate gigabytes.
+ *
+ *      SETUP  setup                      what the worker should run
+ *      EVAL   batch, n*d doubles         rows to evaluate (tag echoes back)
+ *      COST   batch, n doubles           their costs, in order
+ *      BEST   best, d doubles            a best solution, either way
+ *      BYE    -                          stop; the peer may close
+ */
+namespace wire
+{
+
+enum type : std::uint32_t { SETUP = 1, EVAL = 2, COST = 3, BEST = 4, BYE = 5 };
+enum mode : std::uint32_t { EVALUATE = 1, ISLAND = 2 };
+
+struct header { std::uint32_t type; std::uint32_t size; };
+struct setup
+{
+    std::uint32_t mode;
+    std::uint32_t d;
+    std::uint64_t seed;
+    std::int64_t interval;
+    std::uint64_t batch;        // most rows in one EVAL
+    char name[32];
+};
+struct batch { std::uint64_t tag; std::uint32_t n; std::uint32_t d; };
+struct best { double cost; std::uint64_t evaluations; };
+
+/** Send one frame made of a fixed part and an optional array of doubles. */
+template <typename Fixed>
+inline bool send ( int fd, type t, Fixed const& fixed, double const* x = nullptr, std::size_t n = 0 )
+{
+    std::vector<char> buffer(sizeof(header) + sizeof(Fixed) + n * sizeof(double));
+    header h { t, std::uint32_t(sizeof(Fixed) + n * sizeof(double)) };
+    std::memcpy(buffer.data(), &h, sizeof h);
+    std::memcpy(buffer.data() + sizeof h, &fixed, sizeof fixed);
+    if (n) { std::memcpy(buffer.data() + sizeof h + sizeof fixed, x, n * sizeof(double)); }
+    return net::send_all(fd, buffer.data(), buffer.size());
+}
+
+inline bool send_bye ( int fd )
+{
+    header h { BYE, 0 };
+    return net::send_all(fd, &h, sizeof h);
+}
+
+/** Payload bytes of a frame of a fixed part and n doubles, saturated at
+ *  what a header can state. */
+inline auto limit ( std::size_t fixed, std::uint64_t n ) -> std::uint64_t
+    { return n > (UINT32_MAX - fixed) / sizeof(double) ? UINT32_MAX : fixed + n * sizeof(double); }
+
+/** Read one frame of at most `most` payload bytes; false if the peer is
+ *  gone or sent garbage. */
+inline bool receive ( int fd, header& h, std::vector<char>& payload, std::uint64_t most )
+{
+    if (!net::recv_all(fd, &h, sizeof h) || h.type < SETUP || h.type > BYE || h.size > most)
+        { return false; }
+    payload.resize(h.size);
+    return h.size == 0 || net::recv_all(fd, payload.data(), h.size);
+}
+
+}
+
+/** Objective whose batches are evaluated by remote workers.
+ *
+ *  evaluate() cuts the rows into batches and keeps up to `window` of
+ *  them in flight on every worker, so the link stays busy while the far
+ *  side computes; replies come back in order per worker and are matched
+ *  by tag. A worker that drops its connection, or leaves a batch
+ *  unanswered for `timeout` (a stopped process, a partition), is retired
+ *  and its outstanding batches go to the others, or are evaluated locally
+ *  once nobody is left. operator() is a batch of one, so engines that hand
+ *  over whole sweeps at a time get the throughput. Not thread-safe: one
+ *  caller at a time.
+ */
+class remote_objective : public objective
+{
+public:
+    remote_objective ( std::vector<net::socket> workers, std::string const& name,
+                       std::size_t d, std::size_t batch = 256, std::size_t window = 4,
+                       std::chrono::milliseconds timeout = std::chrono::seconds(30) )
+        : local(make_objective(name)), batch(std::max<std::size_t>(1, batch)),
+          window(std::max<std::size_t>(1, window)), timeout(timeout), tag(0)
+    {
+        if (!local) { throw std::invalid_argument("unknown objective " + name); }
+        wire::setup s {};
+        s.mode = wire::EVALUATE;
+        s.d = std::uint32_t(d);
+        s.batch = this->batch;
+        std::strncpy(s.name, name.c_str(), sizeof s.name - 1);
+        for ( auto& w : workers ) {
+            net::send_timeout(w.get(), timeout);
+            if (wire::send(w.get(), wire::SETUP, s)) { peers.emplace_back(std::move(w)); }
+        }
+    }
+
+    ~remote_objective()
+    {
+        for ( auto& p : peers ) { if (p.fd) { wire::send_bye(p.fd.get()); } }
+    }
+
+    /** Workers still connected. */
+    auto workers() const -> std::size_t
+        { return std::count_if(peers.begin(), peers.end(), [](peer const& p) { return bool(p.fd); }); }
+
+    auto operator() ( param a, param b ) const -> double
+    {
+        double cost;
+        evaluate(a, 1, std::size_t(b - a), std::size_t(b - a), &cost);
+        return cost;
+    }
+
+    void evaluate ( double const* x, std::size_t n, std::size_t d,
+                    std::size_t pitch, double* cost ) const
+    {
+        std::deque<job> pending;
+        for ( std::size_t i = 0; i < n; i += batch )
+            { pending.push_back(job { tag++, i, std::min(batch, n - i), clock::time_point() }); }
+
+        std::vector<double> rows;
+        auto dispatch = [&](peer& p) {
+            while (p.fd && p.inflight.size() < window && !pending.empty()) {
+                auto j = pending.front();
+                rows.resize(j.count * d);
+                for ( std::size_t k = 0; k < j.count; ++k )
+                    { std::copy(x + (j.first + k) * pitch, x + (j.first + k) * pitch + d, &rows[k * d]); }
+                wire::batch b { j.tag, std::uint32_t(j.count), std::uint32_t(d) };
+                if (!wire::send(p.fd.get(), wire::EVAL, b, rows.data(), rows.size())) {
+                    retire(p, pending);
+                    return;
+                }
+                pending.pop_front();
+                j.sent = clock::now();
+                p.inflight.push_back(j);
+            }
+        };
+
+        std::vector<pollfd> fds;
+        std::vector<peer*> owner;
+        wire::header h;
+        std::vector<char> payload;
+        auto const most = wire::limit(sizeof(wire::batch), batch);
+        while (true) {
+            // a batch answered in order is due `timeout` after it was sent
+            auto now = clock::now();
+            for ( auto& p : peers ) {
+                if (p.fd && !p.inflight.empty() && p.inflight.front().sent + timeout <= now)
+                    { retire(p, pending); }
+            }
+            for ( auto& p : peers ) { dispatch(p); }
+
+            fds.clear();
+            owner.clear();
+            auto next = clock::time_point::max();
+            for ( auto& p : peers ) {
+                if (p.fd && !p.inflight.empty()) {
+                    fds.push_back(pollfd { p.fd.get(), POLLIN, 0 });
+                    owner.push_back(&p);
+                    next = std::min(next, p.inflight.front().sent + timeout);
+                }
+            }
+            if (fds.empty()) { break; }
+            if (::poll(fds.data(), fds.size(), wait(next)) <= 0) { continue; }
+
+            for ( std::size_t k = 0; k < fds.size(); ++k ) {
+                if (!fds[k].revents) { continue; }
+                auto& p = *owner[k];
+                wire::batch b;
+                if (!wire::receive(p.fd.get(), h, payload, most) || h.type != wire::COST
+                    || h.size < sizeof b) {
+                    retire(p, pending);
+                    continue;
+                }
+                std::memcpy(&b, payload.data(), sizeof b);
+                auto j = p.inflight.front();
+                if (b.tag != j.tag || b.n != j.count
+                    || h.size != sizeof b + j.count * sizeof(double)) {
+                    retire(p, pending);
+                    continue;
+                }
+                std::memcpy(cost + j.first, payload.data() + sizeof b, j.count * sizeof(double));
+                p.inflight.pop_front();
+            }
+        }
+
+        // nobody left to ask
+        for ( auto const& j : pending )
+            { local->evaluate(x + j.first * pitch, j.count, d, pitch, cost + j.first); }
+    }
+
+    auto domain ( unsigned i ) const -> domain_type { return local->domain(i); }
+    auto extremum ( unsigned i ) const -> double { return local->extremum(i); }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct job { std::uint64_t tag; std::size_t first; std::size_t count; clock::time_point sent; };
+    struct peer
+    {
+        explicit peer ( net::socket s ) : fd(std::move(s)) {}
+        net::socket fd;
+        std::deque<job> inflight;
+    };
+
+    /* poll timeout in ms until `t`, rounded up */
+    static auto wait ( clock::time_point t ) -> int
+    {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(t - clock::now()).count() + 1;
+        return int(std::max<long long>(0, std::min<long long>(left, INT_MAX)));
+    }
+
+    static void retire ( peer& p, std::deque<job>& pending )
+    {
+        p.fd.close();
+        pending.insert(pending.begin(), p.inflight.begin(), p.inflight.end());
+        p.inflight.clear();
+    }
+
+    std::unique_ptr<objective> local;
+    std::size_t const batch;
+    std::size_t const window;
+    std::chrono::milliseconds const timeout;
+    mutable std::uint64_t tag;
+    mutable std::vector<peer> peers;
+};
+
+/** Coordinator side of the remote island model.
+ *
+ *  Each worker runs a whole pso.hpp swarm. Every `interval` sweeps it
+ *  sends its leader as a BEST frame and gets the coordinator's global
+ *  best back, which it takes in as a migrant. Once the global best hits
+ *  the target, or the stop token expires or the workers' reported
+ *  evaluations exceed its budget, everybody is sent BYE in reply to their
+ *  next report. A worker that disappears, or goes `timeout` without a
+ *  report, is simply dropped; its last report still counts.
+ */
+class remote_islands
+{
+public:
+    using solution = swarm::solution;
+
+    remote_islands ( std::vector<net::socket> workers, std::string const& name,
+                     std::size_t d, long interval = 20,
+                     std::uint64_t seed = std::random_device()(),
+                     std::chrono::milliseconds timeout = std::chrono::seconds(30) )
+        : d(d), timeout(timeout), best(std::numeric_limits<double>::infinity(), std::vector<double>(d))
+    {
+        wire::setup s {};
+        s.mode = wire::ISLAND;
+        s.d = std::uint32_t(d);
+        s.interval = interval;
+        std::strncpy(s.name, name.c_str(), sizeof s.name - 1);
+        for ( auto& w : workers ) {
+            s.seed = seed + peers.size();
+            net::send_timeout(w.get(), timeout);
+            if (wire::send(w.get(), wire::SETUP, s)) { peers.emplace_back(std::move(w)); }
+        }
+        evaluations_.resize(peers.size(), 0);
+        heard.resize(peers.size(), clock::now());
+    }
+
+    void operator() ()
+    {
+        std::vector<pollfd> fds;
+        std::vector<std::size_t> owner;
+        wire::header h;
+        std::vector<char> payload;
+        auto done = false;
+        auto const most = wire::limit(sizeof(wire::best), d);
+        while (true) {
+            fds.clear();
+            owner.clear();
+            auto now = clock::now();
+            for ( std::size_t i = 0; i < peers.size(); ++i ) {
+                if (peers[i] && heard[i] + timeout <= now) { peers[i].close(); }
+                if (peers[i]) {
+                    fds.push_back(pollfd { peers[i].get(), POLLIN, 0 });
+                    owner.push_back(i);
+                }
+            }
+            if (fds.empty()) { break; }
+            done = done || token.expired() || evaluations() > token.budget();
+            if (::poll(fds.data(), fds.size(), POLL) <= 0) { continue; }
+
+            for ( std::size_t k = 0; k < fds.size(); ++k ) {
+                if (!fds[k].revents) { continue; }
+                auto& p = peers[owner[k]];
+                wire::best b;
+                heard[owner[k]] = clock::now();
+                if (!wire::receive(p.get(), h, payload, most) || h.type == wire::BYE) {
+                    p.close();
+                    continue;
+                }
+                if (h.type != wire::BEST || h.size != sizeof b + d * sizeof(double)) {
+                    p.close();
+                    continue;
+                }
+                std::memcpy(&b, payload.data(), sizeof b);
+                evaluations_[owner[k]] = b.evaluations;
+                if (b.cost < best.first) {
+                    best.first = b.cost;
+                    std::memcpy(best.second.data(), payload.data() + sizeof b, d * sizeof(double));
+                }
+                done = done || best.first < 0.1;
+                if (done) {
+                    wire::send_bye(p.get());
+                } else {
+                    wire::best g { best.first, 0 };
+                    if (!wire::send(p.get(), wire::BEST, g, best.second.data(), d)) { p.close(); }
+                }
+            }
+        }
+    }
+
+    solution best_solution() const { return best; }
+
+    auto evaluations() const -> long long
+    {
+        auto k = 0LL;
+        for ( auto e : evaluations_ ) { k += e; }
+        return k;
+    }
+
+    /** Deadline, budget and stop requests for the run. */
+    auto stop() const -> stop_token const& { return token; }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    /* milliseconds to wait for a report before looking at the token */
+    static int const POLL = 50;
+
+    std::size_t const d;
+    std::chrono::milliseconds const timeout;
+    std::vector<net::socket> peers;
+    std::vector<clock::time_point> heard;
+    solution best;
+    std::vector<long long> evaluations_;
+    stop_token token;
+};
+
+/** Worker side: serve one coordinator connection until BYE or EOF. */
+inline void serve ( net::socket s )
+{
+    wire::header h;
+    std::vector<char> payload;
+    wire::setup setup;
+    if (!wire::receive(s.get(), h, payload, sizeof setup) || h.type != wire::SETUP || h.size != sizeof setup)
+        { return; }
+    std::memcpy(&setup, payload.data(), sizeof setup);
+    setup.name[sizeof setup.name - 1] = 0;
+    std::unique_ptr<objective> f(make_objective(setup.name));
+    if (!f) { return; }
+    std::size_t const d = setup.d;
+
+    if (setup.mode == wire::EVALUATE) {
+        std::vector<double> cost;
+        auto const most = wire::limit(sizeof(wire::batch), std::min<std::uint64_t>(setup.batch, UINT32_MAX) * d);
+        while (wire::receive(s.get(), h, payload, most) && h.type == wire::EVAL) {
+            wire::batch b;
+            if (h.size < sizeof b) { return; }
+            std::memcpy(&b, payload.data(), sizeof b);
+            if (b.d != d || h.size != sizeof b + std::size_t(b.n) * d * sizeof(double)) { return; }
+            // the rows are not 8-byte aligned inside the payload
+            std::vector<double> x(std::size_t(b.n) * d);
+            std::memcpy(x.data(), payload.data() + sizeof b, x.size() * sizeof(double));
+            cost.resize(b.n);
+            f->evaluate(x.data(), b.n, d, d, cost.data());
+            if (!wire::send(s.get(), wire::COST, b, cost.data(), b.n)) { return; }
+        }
+        return;
+    }
+
+    if (setup.mode == wire::ISLAND) {
+        swarm island(int(d), f.release(), {20,2.0,2.0,1.0,1.0,0.95,0.5,0.95,200}, setup.seed);
+        migration_param m { setup.interval, 1, migration_param::topology::ring,
+                            migration_param::replacement::worse };
+        std::vector<double> g(d);
+        island.initialize();
+        for ( auto sweep = 1L; ; ++sweep ) {
+            auto going = island.step();
+            if (going && (setup.interval <= 0 || sweep % setup.interval != 0)) { continue; }
+
+            auto l = island.leading();
+            wire::best b { island.cost(l), std::uint64_t(island.evaluations()) };
+            if (!wire::send(s.get(), wire::BEST, b, island.best(l), d)) { return; }
+            if (!going) { break; }
+
+            if (!wire::receive(s.get(), h, payload, wire::limit(sizeof b, d)) || h.type != wire::BEST
+                || h.size != sizeof b + d * sizeof(double)) { return; }
+            std::memcpy(&b, payload.data(), sizeof b);
+            std::memcpy(g.data(), payload.data() + sizeof b, d * sizeof(double));
+            auto v = m.victim(island, b.cost, 0.0);
+            if (v < island.size()) { island.immigrate(v, b.cost, g.data()); }
+        }
+        wire::send_bye(s.get());
+    }
+}
+
+#endif
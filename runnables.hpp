@@ -1,7 +1,12 @@
 #ifndef HPP_RUNNABLES
 #define HPP_RUNNABLES
 
+#include "stop.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
 #include <thread>
+#include <utility>
 
 /** */
 template <typename Runnable>
@@ -29,13 +34,54 @@ private:
         void* m_task;
 };
 
-/** */
+/** Thread that runs its own operator(). Loops in operator() are expected
+ *  to watch stop() (via stop_poll, or stop_requested() for slow loops)
+ *  and return once it expires; request_stop() asks them to. */
 class runnable
         : public std::thread
 {
 public:
+        explicit runnable ( stop_token t = stop_token() ) : m_stop(std::move(t)) {}
         virtual void operator() () = 0;
         virtual void run() final { dynamic_cast<std::thread&>(*this) = std::thread(&runnable::operator(),this); }
+        void request_stop() const { m_stop.request_stop(); }
+        auto stop() const -> stop_token const& { return m_stop; }
+protected:
+        bool stop_requested() const { return m_stop.expired(); }
+private:
+        stop_token m_stop;
+};
+
+/** Reusable barrier for a fixed set of threads. The last thread to arrive
+ *  runs `completion` on its own before anyone is released, which gives
+ *  synchronous engines a serial section between phases. */
+class barrier
+{
+public:
+        explicit barrier ( std::size_t count )
+                : m_count(count), m_waiting(0), m_generation(0) {}
+
+        template <typename Completion>
+        void arrive_and_wait ( Completion&& completion )
+        {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                auto generation = m_generation;
+                if (++m_waiting == m_count) {
+                        completion();
+                        m_waiting = 0;
+                        ++m_generation;
+                        m_released.notify_all();
+                } else {
+                        m_released.wait(lock, [&]{ return generation != m_generation; });
+                }
+        }
+        void arrive_and_wait() { arrive_and_wait([]{}); }
+private:
+        std::mutex m_mutex;
+        std::condition_variable m_released;
+        std::size_t const m_count;
+        std::size_t m_waiting;
+        unsigned long m_generation;
 };
 
 #endif
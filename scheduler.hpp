@@ -0,0 +1,159 @@
+#ifndef HPP_SCHEDULER
+#define HPP_SCHEDULER
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/** Work-stealing task pool with one deque per worker thread.
+ *
+ *  A task submitted from a worker goes on that worker's own deque; one
+ *  submitted from outside is dealt round-robin. A worker serves its deque
+ *  front to back, so a particle task that resubmits itself queues up
+ *  behind its siblings instead of starving them, and an idle worker
+ *  steals from the back of a victim's deque. Workers with nothing to do
+ *  park on a condition variable; submit() only touches it when somebody
+ *  is parked.
+ */
+class scheduler
+{
+public:
+    using task = std::function<void()>;
+
+    explicit scheduler ( unsigned threads = std::thread::hardware_concurrency() )
+        : queues(std::max(1U, threads)), next(0), queued(0), pending(0),
+          sleeping(0), stopping(false)
+    {
+        for ( auto& q : queues ) { q.reset(new queue()); }
+        for ( std::size_t i = 0; i < queues.size(); ++i )
+            { workers.emplace_back(&scheduler::work, this, i); }
+    }
+
+    scheduler ( scheduler const& ) = delete;
+    scheduler& operator= ( scheduler const& ) = delete;
+
+    ~scheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(park);
+            stopping = true;
+        }
+        wake.notify_all();
+        for ( auto& t : workers ) { t.join(); }
+    }
+
+    auto size() const -> std::size_t { return queues.size(); }
+    /** Index of the calling thread among this pool's workers, or size()
+     *  if it is not one of them. */
+    auto index() const -> std::size_t
+    {
+        auto self = current();
+        return self.first == this ? self.second : size();
+    }
+
+    void submit ( task t )
+    {
+        auto self = current();
+        auto i = self.first == this ? self.second
+                                    : next.fetch_add(1, std::memory_order_relaxed) % queues.size();
+        pending.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(queues[i]->mutex);
+            queues[i]->tasks.push_back(std::move(t));
+        }
+        queued.fetch_add(1);
+        if (sleeping.load() > 0) {
+            std::lock_guard<std::mutex> lock(park);
+            wake.notify_one();
+        }
+    }
+
+    /** Block until every submitted task, including ones they submitted,
+     *  has finished. */
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(park);
+        idle.wait(lock, [this]{ return pending.load() == 0; });
+    }
+
+private:
+    struct queue
+    {
+        std::mutex mutex;
+        std::deque<task> tasks;
+        char padding[64];   // keep neighbouring queues off each other's lines
+    };
+
+    /* (pool, worker index) of the calling thread */
+    static auto current() -> std::pair<scheduler*,std::size_t>&
+    {
+        static thread_local std::pair<scheduler*,std::size_t> self(nullptr, 0);
+        return self;
+    }
+
+    bool pop ( std::size_t i, task& t )
+    {
+        std::lock_guard<std::mutex> lock(queues[i]->mutex);
+        if (queues[i]->tasks.empty()) { return false; }
+        t = std::move(queues[i]->tasks.front());
+        queues[i]->tasks.pop_front();
+        return true;
+    }
+
+    bool steal ( std::size_t i, task& t )
+    {
+        for ( std::size_t k = 1; k < queues.size(); ++k ) {
+            auto& q = *queues[(i + k) % queues.size()];
+            std::unique_lock<std::mutex> lock(q.mutex, std::try_to_lock);
+            if (!lock || q.tasks.empty()) { continue; }
+            t = std::move(q.tasks.back());
+            q.tasks.pop_back();
+            return true;
+        }
+        return false;
+    }
+
+    void work ( std::size_t i )
+    {
+        current() = std::make_pair(this, i);
+        task t;
+        while (true) {
+            if (queued.load() > 0 && (pop(i, t) || steal(i, t))) {
+                queued.fetch_sub(1);
+                t();
+                t = nullptr;
+                if (pending.fetch_sub(1) == 1) {
+                    std::lock_guard<std::mutex> lock(park);
+                    idle.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(park);
+            sleeping.fetch_add(1);
+            wake.wait(lock, [this]{ return stopping || queued.load() > 0; });
+            sleeping.fetch_sub(1);
+            if (stopping) { return; }
+        }
+    }
+
+    std::vector<std::unique_ptr<queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<std::size_t> next;
+    std::atomic<long> queued;     // sitting in a deque
+    std::atomic<long> pending;    // submitted and not yet finished
+    std::atomic<int> sleeping;
+    bool stopping;
+    std::mutex park;
+    std::condition_variable wake;
+    std::condition_variable idle;
+};
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef HPP_SHAREDBEST
+#define HPP_SHAREDBEST
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <thread>
+
+/** Global best shared by concurrent swarm members without a lock.
+ *
+ *  The cost is a plain atomic, so "is mine better?" is one load. The
+ *  position sits behind a sequence lock: an odd sequence number means a
+ *  write is in progress, and readers copy the buffer and retry if the
+ *  number moved underneath them. Readers therefore never block a writer
+ *  or each other. Writers race on the sequence number with a CAS, and an
+ *  offer only lands when its cost is strictly below the published one,
+ *  so the published cost only ever goes down.
+ *
+ *  The buffer holds relaxed atomics rather than plain doubles so that the
+ *  racy copy is well defined; on x86 they compile to ordinary moves.
+ *
+ *  The state is one flat block of bytes(n) bytes with no pointers in it,
+ *  so it can also live in memory shared between processes: construct a
+ *  view over it in each process, and have exactly one of them pass
+ *  init = true first. A process that dies while it writes would leave the
+ *  sequence odd for good, so a writer that can die on its own passes a
+ *  writer number, kept in the top bits of the odd sequence, and whoever
+ *  reaps it calls recover() with that number.
+ */
+class shared_best
+{
+public:
+    explicit shared_best ( std::size_t n )
+        : shared_best(n, nullptr, true) {}
+
+    shared_best ( std::size_t n, void* storage, bool init )
+        : n(n), owned(storage ? nullptr : new char[bytes(n)])
+    {
+        auto base = storage ? static_cast<char*>(storage) : owned.get();
+        if (init) {
+            seq = new (base) std::atomic<std::uint64_t>(0);
+            best = new (base + sizeof(std::uint64_t)) std::atomic<double>(std::numeric_limits<double>::infinity());
+            for ( std::size_t j = 0; j < n; ++j )
+                { new (base + HEADER + j * sizeof(std::atomic<double>)) std::atomic<double>(0.0); }
+        } else {
+            seq = reinterpret_cast<std::atomic<std::uint64_t>*>(base);
+            best = reinterpret_cast<std::atomic<double>*>(base + sizeof(std::uint64_t));
+        }
+        position = reinterpret_cast<std::atomic<double>*>(base + HEADER);
+    }
+
+    /** Size of the block behind a shared_best of n dimensions. */
+    static auto bytes ( std::size_t n ) -> std::size_t
+        { return HEADER + n * sizeof(std::atomic<double>); }
+
+    shared_best ( shared_best const& ) = delete;
+    shared_best& operator= ( shared_best const& ) = delete;
+
+    auto size() const -> std::size_t { return n; }
+
+    /** Published cost; never blocks. */
+    auto cost() const -> double { return best->load(std::memory_order_acquire); }
+
+    /** Number of offers that have landed so far. */
+    auto version() const -> std::uint64_t
+        { return (seq->load(std::memory_order_acquire) & COUNT) >> 1; }
+
+    /** Copy a consistent (cost, position) pair into out[0..size()) and
+     *  return the cost. Spins only while a write is in flight. */
+    auto read ( double* out ) const -> double
+    {
+        while (true) {
+            auto s0 = seq->load(std::memory_order_acquire);
+            if (s0 & 1) { std::this_thread::yield(); continue; }
+            auto c = best->load(std::memory_order_relaxed);
+            for ( std::size_t j = 0; j < n; ++j )
+                { out[j] = position[j].load(std::memory_order_relaxed); }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq->load(std::memory_order_relaxed) == s0) { return c; }
+        }
+    }
+
+    /** One attempt at read(): false, with `out` and `c` unspecified, if a
+     *  write is in flight. Never spins, so it is safe while a dead writer
+     *  still holds the write side. */
+    bool try_read ( double* out, double& c ) const
+    {
+        auto s0 = seq->load(std::memory_order_acquire);
+        if (s0 & 1) { return false; }
+        c = best->load(std::memory_order_relaxed);
+        for ( std::size_t j = 0; j < n; ++j )
+            { out[j] = position[j].load(std::memory_order_relaxed); }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return seq->load(std::memory_order_relaxed) == s0;
+    }
+
+    /** Publish (c, x) if c is strictly below the current cost. Returns
+     *  whether it did. Losing offers cost a single load. `writer` (below
+     *  WRITERS) names the offering process for recover(). */
+    bool offer ( double c, double const* x, unsigned writer = 0 )
+    {
+        if (!(c < cost())) { return false; }
+
+        // take the write side: even -> odd
+        auto s = seq->load(std::memory_order_relaxed);
+        do {
+            if (s & 1) {
+                std::this_thread::yield();
+                s = seq->load(std::memory_order_relaxed);
+                continue;
+            }
+            if (seq->compare_exchange_weak(s, (s + 1) | tag(writer), std::memory_order_acquire,
+                                          std::memory_order_relaxed)) { break; }
+        } while (true);
+
+        // someone better may have landed while we waited
+        if (!(c < best->load(std::memory_order_relaxed))) {
+            seq->store(s, std::memory_order_release);
+            return false;
+        }
+
+        std::atomic_thread_fence(std::memory_order_release);
+        for ( std::size_t j = 0; j < n; ++j )
+            { position[j].store(x[j], std::memory_order_relaxed); }
+        best->store(c, std::memory_order_release);
+        seq->store(s + 2, std::memory_order_release);
+        return true;
+    }
+
+    /** Release the write side if `writer`, now dead, died holding it.
+     *  Its position may be half written, so (c, x), a pair read before
+     *  (try_read), is put back in its place; an infinite c with no x
+     *  just withdraws the pair. Returns whether there was anything to
+     *  release. */
+    bool recover ( unsigned writer, double c, double const* x )
+    {
+        auto s = seq->load(std::memory_order_acquire);
+        if (!(s & 1) || (s & ~COUNT) != tag(writer)) { return false; }
+        if (x) {
+            for ( std::size_t j = 0; j < n; ++j )
+                { position[j].store(x[j], std::memory_order_relaxed); }
+        }
+        best->store(c, std::memory_order_relaxed);
+        return seq->compare_exchange_strong(s, (s & COUNT) + 1, std::memory_order_release);
+    }
+
+    /** Writers recover() can tell apart. */
+    static unsigned const WRITERS = 1U << 16;
+
+private:
+    static std::size_t const HEADER = 64;
+    /* the low 48 bits of the sequence count; a writer's number sits above */
+    static std::uint64_t const COUNT = (std::uint64_t(1) << 48) - 1;
+
+    static auto tag ( unsigned writer ) -> std::uint64_t { return std::uint64_t(writer) << 48; }
+
+    std::size_t const n;
+    std::unique_ptr<char[]> owned;
+    std::atomic<std::uint64_t>* seq;
+    std::atomic<double>* best;
+    std::atomic<double>* position;
+};
+
+#endif
@@ -0,0 +1,429 @@
+#ifndef HPP_SHMISLANDS
+#define HPP_SHMISLANDS
+
+#include "islands.hpp"
+#include "sharedbest.hpp"
+#include "stop.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/** Anonymous-by-name POSIX shared memory: created, sized and mapped, then
+ *  unlinked at once so nothing is left behind if a process dies. Children
+ *  forked afterwards inherit the mapping at the same address. */
+class shm_segment
+{
+public:
+    explicit shm_segment ( std::size_t bytes )
+        : length(bytes), base(nullptr)
+    {
+        auto name = "/graphswarm-" + std::to_string(::getpid());
+        int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0) { throw std::system_error(errno, std::generic_category(), "shm_open"); }
+        ::shm_unlink(name.c_str());
+        if (::ftruncate(fd, off_t(length)) != 0) {
+            auto e = errno;
+            ::close(fd);
+            throw std::system_error(e, std::generic_category(), "ftruncate");
+        }
+        auto p = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) { throw std::system_error(errno, std::generic_category(), "mmap"); }
+        base = static_cast<char*>(p);
+    }
+
+    shm_segment ( shm_segment const& ) = delete;
+    shm_segment& operator= ( shm_segment const& ) = delete;
+
+    ~shm_segment() { if (base) { ::munmap(base, length); } }
+
+    auto data() const -> char* { return base; }
+    auto size() const -> std::size_t { return length; }
+
+private:
+    std::size_t length;
+    char* base;
+};
+
+/** Bounded MPMC ring of migrants in a flat block of bytes(capacity, d)
+ *  bytes. Same per-cell sequence protocol as channel<T>, but a cell holds
+ *  the migrant itself, (cost, x[0..d)), and both ends work on it in
+ *  place: try_push hands the writer the cell to fill straight from its
+ *  swarm, try_pop hands the reader the cell to copy straight into its
+ *  own. Nothing is staged in between.
+ *
+ *  A writer claims its cell by marking the cell's sequence busy with its
+ *  writer number before it moves the tail on (anyone who finds the tail
+ *  on a busy cell moves it on for it). A writer that dies while it fills
+ *  the cell therefore leaves its number behind, and recover() turns the
+ *  cell into an abandoned one that the reader skips, instead of a hole
+ *  that blocks the ring. */
+class shm_ring
+{
+public:
+    shm_ring ( void* storage, std::size_t capacity, std::size_t d, bool init )
+        : base(static_cast<char*>(storage)), mask(capacity - 1), d(d), stride(cell_bytes(d))
+    {
+        if (init) {
+            new (base) std::atomic<std::size_t>(0);
+            new (base + LINE) std::atomic<std::size_t>(0);
+            for ( std::size_t c = 0; c < capacity; ++c )
+                { new (cell(c)) std::atomic<std::size_t>(c); }
+        }
+    }
+
+    /** Bytes needed for a ring of the given capacity (a power of two). */
+    static auto bytes ( std::size_t capacity, std::size_t d ) -> std::size_t
+        { return 2 * LINE + capacity * cell_bytes(d); }
+
+    /** write(double& cost, double* x) fills a free cell; `writer` (below
+     *  WRITERS) names the writing process for recover(). */
+    template <typename Write>
+    bool try_push ( Write write, unsigned writer = 0 )
+    {
+        auto& tail = counter(1);
+        auto pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            auto c = cell(pos & mask);
+            auto seq = sequence(c).load(std::memory_order_acquire);
+            auto diff = std::ptrdiff_t(seq) - std::ptrdiff_t(pos);
+            if (seq & BUSY) {
+                // claimed but the tail not yet moved past it
+                auto t = pos;
+                if ((seq & COUNT) == pos) { tail.compare_exchange_strong(t, pos + 1, std::memory_order_relaxed); }
+                pos = tail.load(std::memory_order_relaxed);
+            } else if (diff == 0) {
+                if (sequence(c).compare_exchange_weak(seq, pos | BUSY | tag(writer), std::memory_order_relaxed)) {
+                    auto t = pos;
+                    tail.compare_exchange_strong(t, pos + 1, std::memory_order_relaxed);
+                    write(payload(c)[0], payload(c) + 1);
+                    sequence(c).store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+                pos = tail.load(std::memory_order_relaxed);
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /** read(double cost, double const* x) consumes the oldest cell;
+     *  abandoned cells are passed over. */
+    template <typename Read>
+    bool try_pop ( Read read )
+    {
+        auto& head = counter(0);
+        auto pos = head.load(std::memory_order_relaxed);
+        while (true) {
+            auto c = cell(pos & mask);
+            auto seq = sequence(c).load(std::memory_order_acquire);
+            auto diff = std::ptrdiff_t(seq) - std::ptrdiff_t(pos + 1);
+            if (seq & BUSY) {
+                return false;
+            } else if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    auto abandoned = std::isnan(payload(c)[0]);
+                    if (!abandoned) { read(payload(c)[0], static_cast<double const*>(payload(c) + 1)); }
+                    sequence(c).store(pos + mask + 1, std::memory_order_release);
+                    if (!abandoned) { return true; }
+                    pos = head.load(std::memory_order_relaxed);
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /** Give up the cells `writer`, now dead, was filling: each becomes an
+     *  abandoned cell. Returns how many there were. */
+    auto recover ( unsigned writer ) -> std::size_t
+    {
+        auto& tail = counter(1);
+        std::size_t n = 0;
+        for ( std::size_t i = 0; i <= mask; ++i ) {
+            auto c = cell(i);
+            auto seq = sequence(c).load(std::memory_order_acquire);
+            if (!(seq & BUSY) || (seq & ~COUNT) != (BUSY | tag(writer))) { continue; }
+            auto pos = seq & COUNT;
+            auto t = pos;
+            tail.compare_exchange_strong(t, pos + 1, std::memory_order_relaxed);
+            payload(c)[0] = std::numeric_limits<double>::quiet_NaN();
+            sequence(c).store(pos + 1, std::memory_order_release);
+            ++n;
+        }
+        return n;
+    }
+
+    /** Writers recover() can tell apart. */
+    static unsigned const WRITERS = 1U << 15;
+
+private:
+    static std::size_t const LINE = 64;
+    /* a claimed cell's sequence: busy, the writer's number, the position */
+    static std::size_t const BUSY = std::size_t(1) << 63;
+    static std::size_t const COUNT = (std::size_t(1) << 48) - 1;
+
+    static auto tag ( unsigned writer ) -> std::size_t { return std::size_t(writer) << 48; }
+
+    /* sequence word, cost, d coordinates; rounded up to whole lines */
+    static auto cell_bytes ( std::size_t d ) -> std::size_t
+        { return (sizeof(std::size_t) + (d + 1) * sizeof(double) + LINE - 1) / LINE * LINE; }
+
+    auto counter ( int i ) -> std::atomic<std::size_t>&
+        { return *reinterpret_cast<std::atomic<std::size_t>*>(base + i * LINE); }
+    auto cell ( std::size_t c ) -> char* { return base + 2 * LINE + c * stride; }
+    static auto sequence ( char* c ) -> std::atomic<std::size_t>&
+        { return *reinterpret_cast<std::atomic<std::size_t>*>(c); }
+    static auto payload ( char* c ) -> double*
+        { return reinterpret_cast<double*>(c + sizeof(std::size_t)); }
+
+    char* base;
+    std::size_t mask;
+    std::size_t d;
+    std::size_t stride;
+};
+
+/** Island model with one forked worker process per island.
+ *
+ *  The coordinator lays out a single shared memory segment: a stop flag,
+ *  one status line per island, the global best (a shared_best) and one
+ *  migrant ring per island. Workers run the pso.hpp swarm exactly as the
+ *  threaded archipelago does, publishing their leader to the global best
+ *  after every sweep and treating a better global best as one more
+ *  migrant. Workers share nothing but the segment, so a worker that
+ *  crashes only loses its own island; the coordinator reaps it, counts it
+ *  in failures(), releases whatever the worker was writing when it died
+ *  (the global best, cells of other islands' rings) and lets the others
+ *  finish. A global best caught half written goes back to the last one
+ *  the coordinator read, on its previous look.
+ *
+ *  While it waits, the coordinator looks at its stop token every POLL
+ *  milliseconds and raises the shared stop flag once the token expires or
+ *  the islands together have spent its budget; workers see the flag
+ *  after their current sweep. Timers live on the coordinator's wheel
+ *  thread, which fork() does not copy, so the factory must not arm any
+ *  in the workers.
+ */
+class process_archipelago
+{
+public:
+    using solution = swarm::solution;
+    using factory = archipelago::factory;
+
+    process_archipelago ( unsigned k, std::size_t d, factory make, migration_param m,
+                          std::uint64_t seed = std::random_device()() )
+        : k(std::max(1U, k)), d(d), make(make), param(m), capacity(1), crashed(0), rng(seed),
+          last(d), spare(d), last_cost(std::numeric_limits<double>::infinity())
+    {
+        // workers write as 1..k, and a number must tell them apart
+        if (this->k >= shm_ring::WRITERS || this->k >= shared_best::WRITERS)
+            { throw std::system_error(EINVAL, std::generic_category(), "process_archipelago: too many islands"); }
+        while (capacity < 2 * this->k * std::max(1U, m.migrants)) { capacity <<= 1; }
+        segment.reset(new shm_segment(ring_offset() + this->k * shm_ring::bytes(capacity, d)));
+        auto base = segment->data();
+        new (base) std::atomic<int>(0);
+        for ( auto i = 0U; i < this->k; ++i ) {
+            new (status(i)) island_status();
+            shm_ring(ring(i), capacity, d, true);
+        }
+        global.reset(new shared_best(d, base + best_offset(), true));
+    }
+
+    void operator() ()
+    {
+        std::vector<std::pair<pid_t,unsigned>> workers;
+        for ( auto i = 0U; i < k; ++i ) {
+            auto pid = ::fork();
+            if (pid < 0) {
+                stop_flag().store(1);
+                break;
+            }
+            if (pid == 0) {
+                int code = 0;
+                try { run(i); } catch (...) { code = 2; }
+                ::_exit(code);
+            }
+            workers.emplace_back(pid, i);
+        }
+        crashed += k - workers.size();
+        while (!workers.empty()) {
+            for ( auto w = workers.begin(); w != workers.end(); ) {
+                int st = 0;
+                auto r = ::waitpid(w->first, &st, WNOHANG);
+                if (r == 0 || (r < 0 && errno == EINTR)) {
+                    ++w;
+                    continue;
+                }
+                if (r < 0 || !WIFEXITED(st) || WEXITSTATUS(st) != 0) {
+                    ++crashed;
+                    recover(w->second);
+                }
+                w = workers.erase(w);
+            }
+            if (workers.empty()) { break; }
+            remember();
+            if (token.expired() || evaluations() > token.budget()) { stop_flag().store(1); }
+            std::this_thread::sleep_for(std::chrono::milliseconds(POLL));
+        }
+    }
+
+    /** Deadline, budget (over all islands) and stop requests for the run. */
+    auto stop() const -> stop_token const& { return token; }
+
+    auto size() const -> std::size_t { return k; }
+    /** Islands whose process died or could not be started. */
+    auto failures() const -> unsigned { return crashed; }
+
+    solution best_solution() const
+    {
+        solution best(0.0, std::vector<double>(d));
+        best.first = global->read(best.second.data());
+        return best;
+    }
+
+    /** Best cost so far over all islands; safe while the run is on. */
+    auto best_cost() const -> double
+    {
+        auto c = std::numeric_limits<double>::infinity();
+        for ( auto i = 0U; i < k; ++i )
+            { c = std::min(c, status(i)->best.load(std::memory_order_relaxed)); }
+        return c;
+    }
+
+    /** Best cost island i reported before it stopped. */
+    auto island_cost ( std::size_t i ) const -> double
+        { return status(i)->best.load(std::memory_order_relaxed); }
+
+    auto evaluations() const -> long long
+    {
+        auto e = 0LL;
+        for ( auto i = 0U; i < k; ++i )
+            { e += status(i)->evaluations.load(std::memory_order_relaxed); }
+        return e;
+    }
+
+private:
+    static std::size_t const LINE = 64;
+    /* milliseconds between looks at the workers and the stop token */
+    static int const POLL = 10;
+
+    auto best_offset() const -> std::size_t { return LINE + k * sizeof(island_status); }
+    auto ring_offset() const -> std::size_t
+        { return (best_offset() + shared_best::bytes(d) + LINE - 1) / LINE * LINE; }
+
+    auto stop_flag() const -> std::atomic<int>&
+        { return *reinterpret_cast<std::atomic<int>*>(segment->data()); }
+    auto status ( std::size_t i ) const -> island_status*
+        { return reinterpret_cast<island_status*>(segment->data() + LINE) + i; }
+    auto ring ( std::size_t i ) const -> char*
+        { return segment->data() + ring_offset() + i * shm_ring::bytes(capacity, d); }
+
+    /* a consistent copy of the global best, kept to repair it with */
+    void remember()
+    {
+        auto c = 0.0;
+        if (global->try_read(spare.data(), c)) {
+            last.swap(spare);
+            last_cost = c;
+        }
+    }
+
+    /* worker `id` is gone: release the global best and the ring cells it
+     * held, under the writer number it used */
+    void recover ( unsigned id )
+    {
+        global->recover(id + 1, last_cost, last.data());
+        for ( auto j = 0U; j < k; ++j ) { shm_ring(ring(j), capacity, d, false).recover(id + 1); }
+    }
+
+    /* body of worker process id, writing as writer id + 1 */
+    void run ( unsigned id )
+    {
+        std::unique_ptr<swarm> s(make(id));
+        shm_ring inbox(ring(id), capacity, d, false);
+        std::vector<double> g(d);
+
+        s->initialize();
+        for ( auto sweep = 1L; !stop_flag().load(std::memory_order_relaxed); ++sweep ) {
+            auto going = s->step();
+            auto leader = s->leading();
+            status(id)->evaluations.store(s->evaluations(), std::memory_order_relaxed);
+            status(id)->best.store(s->cost(leader), std::memory_order_relaxed);
+            global->offer(s->cost(leader), s->best(leader), id + 1);
+            if (!going) {
+                stop_flag().store(1, std::memory_order_relaxed);
+                break;
+            }
+
+            if (param.interval > 0 && sweep % param.interval == 0) {
+                // our best particles, written straight into the destination rings
+                auto out = s->ranking(param.migrants);
+                param.route(id, k, rng(id, sweep, philox::MIGRATION, 0), [&](std::size_t j) {
+                    shm_ring dest(ring(j), capacity, d, false);
+                    for ( auto i : out ) {
+                        dest.try_push([&](double& cost, double* x) {
+                            cost = s->cost(i);
+                            std::copy(s->best(i), s->best(i) + d, x);
+                        }, id + 1);
+                    }
+                });
+                // the global best counts as one more migrant
+                if (global->cost() < s->cost(leader)) {
+                    auto c = global->read(g.data());
+                    auto v = param.victim(*s, c, rng(id, sweep, philox::MIGRATION, 1));
+                    if (v < s->size()) { s->immigrate(v, c, g.data()); }
+                }
+            }
+
+            for ( auto draw = 2UL; ; ++draw ) {
+                auto u = rng(id, sweep, philox::MIGRATION, draw);
+                if (!inbox.try_pop([&](double cost, double const* x) {
+                        auto v = param.victim(*s, cost, u);
+                        if (v < s->size()) { s->immigrate(v, cost, x); }
+                    })) { break; }
+            }
+        }
+    }
+
+    unsigned const k;
+    std::size_t const d;
+    factory make;
+    migration_param param;
+    std::size_t capacity;
+    unsigned crashed;
+    philox rng;
+    std::unique_ptr<shm_segment> segment;
+    std::unique_ptr<shared_best> global;
+    stop_token token;
+    // coordinator only
+    std::vector<double> last;
+    std::vector<double> spare;
+    double last_cost;
+};
+
+#endif
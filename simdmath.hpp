@@ -0,0 +1,278 @@
+#ifndef HPP_SIMDMATH
+#define HPP_SIMDMATH
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* Lanes and scalars must round identically, so no FMA contraction here
+ * (see kernel.hpp). */
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+/** Vectorized cos/exp/sqrt for the benchmark objectives.
+ *
+ *  Each function has a scalar form and an array form; both run the same
+ *  branch-free code (the array form two or, when built for AVX, four lanes
+ *  at a time through GCC vector extensions), so a value gets the same
+ *  answer whichever form computed it.
+ *
+ *  Largest error against a long double reference seen over the ranges the
+ *  objectives use (millions of points, uniform and clustered next to the
+ *  zeros of cos, where an ulp is smallest):
+ *
+ *      function   range              precise     fast
+ *      cos        |x| <= 1000        2.2 ulp     5e-8 absolute
+ *      cos        |x| <= 2^20        2.4 ulp     5e-8 absolute
+ *      exp        [-708, 709]        1 ulp       3e-10 relative
+ *      sqrt       x >= 0             0 ulp       0 ulp
+ *
+ *  The fast cos costs about 3 ns a value against 7 ns for the precise
+ *  one on 64-value chunks (SSE2); the fast exp drops the five highest
+ *  Taylor terms and takes about a third less time.
+ *
+ *  Outside those ranges (and for NaN/inf) the lane falls back to the C
+ *  library, so results stay correct, just not vectorized.
+ */
+namespace simd
+{
+
+enum class accuracy { precise, fast };
+
+/** Bound on the absolute error of the fast cos (see the table above). */
+double const FAST_COS_ERROR = 5e-8;
+
+namespace detail
+{
+
+#if defined(__AVX__)
+std::size_t const BYTES = 32;
+#else
+std::size_t const BYTES = 16;
+#endif
+using vdouble = double __attribute__((vector_size(BYTES)));
+using vint64 = std::int64_t __attribute__((vector_size(BYTES)));
+std::size_t const WIDTH = sizeof(vdouble) / sizeof(double);
+
+inline auto as_int ( double x ) -> std::int64_t
+    { std::int64_t i; std::memcpy(&i, &x, sizeof i); return i; }
+inline auto as_double ( std::int64_t i ) -> double
+    { double x; std::memcpy(&x, &i, sizeof x); return x; }
+inline auto as_int ( vdouble x ) -> vint64 { return (vint64)x; }
+inline auto as_double ( vint64 i ) -> vdouble { return (vdouble)i; }
+
+inline auto select ( bool m, double a, double b ) -> double { return m ? a : b; }
+inline auto select ( vint64 m, vdouble a, vdouble b ) -> vdouble
+    { return as_double((m & as_int(a)) | (~m & as_int(b))); }
+
+/* Round to nearest integer, returned both as a double and as an integer;
+ * valid for |x| < 2^51. */
+double const ROUNDER = 6755399441055744.0; // 1.5 * 2^52
+
+template <typename T, typename I>
+inline auto round ( T x, I& k ) -> T
+{
+    T t = x + ROUNDER;
+    k = as_int(t) - as_int(T{} + ROUNDER);
+    return t - ROUNDER;
+}
+
+/* Cody-Waite split of pi/2 (fdlibm) */
+double const TWO_OVER_PI = 6.36619772367581382433e-01;
+double const PIO2_1  = 1.57079632673412561417e+00;
+double const PIO2_2  = 6.07710050630396597660e-11;
+double const PIO2_3  = 2.02226624879595063154e-21;
+
+/* pi as a double: one reduction step is enough for the fast cos */
+double const ONE_OVER_PI = 3.18309886183790671538e-01;
+double const PI = 3.14159265358979311600e+00;
+
+/* cos(x) = (-1)^k cos(r) with r = x - k pi in [-pi/2, pi/2], and cos(r) a
+ * degree-4 polynomial in r^2 fitted for least maximum error on that
+ * interval (4.7e-8), so there is no sin kernel and no quadrant select. */
+template <typename T, typename I>
+inline auto cos_fast ( T x ) -> T
+{
+    I k;
+    T n = round<T,I>(x * ONE_OVER_PI, k);
+    T r = x - n * PI;
+    T z = r * r;
+    T c = T{} + 2.3154882654307898e-05;
+    c = -1.385375650285967e-03 + z * c;
+    c = 4.1663594188347405e-02 + z * c;
+    c = -4.9999905979542764e-01 + z * c;
+    c = 9.999999545693291e-01 + z * c;
+    return select((k & 1) == 0, c, -c);
+}
+
+template <accuracy A, typename T, typename I>
+inline auto cos ( T x ) -> T
+{
+    if (A == accuracy::fast) { return cos_fast<T,I>(x); }
+    I k;
+    T n = round<T,I>(x * TWO_OVER_PI, k);
+    T r = x - n * PIO2_1;
+    r = r - n * PIO2_2;
+    r = r - n * PIO2_3;
+    T z = r * r;
+
+    // sin(r) and cos(r) on [-pi/4, pi/4] (fdlibm kernels)
+    T ps = z * (-1.98412698298579493134e-04 + z * (2.75573137070700676789e-06
+                + z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)));
+    ps = -1.66666666666666324348e-01 + z * (8.33333333332248946124e-03 + ps);
+    T pc = z * (2.48015872894767294178e-05 + z * (-2.75573143513906633035e-07
+                + z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11)));
+    pc = 4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03 + pc);
+    T s = r + r * z * ps;
+    T hz = 0.5 * z;
+    T w = 1.0 - hz;
+    T c = w + (((1.0 - w) - hz) + z * z * pc);
+
+    // cos(x) = cos r, -sin r, -cos r, sin r by quadrant
+    T v = select((k & 1) == 0, c, s);
+    return select(((k + 1) & 2) == 0, v, -v);
+}
+
+double const LOG2E  = 1.44269504088896338700e+00;
+double const LN2_HI = 6.93147180369123816490e-01;
+double const LN2_LO = 1.90821492927058770002e-10;
+
+template <accuracy A, typename T, typename I>
+inline auto exp ( T x ) -> T
+{
+    I k;
+    T n = round<T,I>(x * LOG2E, k);
+    T r = x - n * LN2_HI;
+    r = r - n * LN2_LO;
+
+    // Taylor series on |r| <= ln(2)/2
+    T p;
+    if (A == accuracy::precise) {
+        p = T{} + 1.0 / 6227020800.0;
+        p = 1.0 / 479001600.0 + r * p;
+        p = 1.0 / 39916800.0 + r * p;
+        p = 1.0 / 3628800.0 + r * p;
+        p = 1.0 / 362880.0 + r * p;
+        p = 1.0 / 40320.0 + r * p;
+    } else {
+        p = T{} + 1.0 / 40320.0;
+    }
+    p = 1.0 / 5040.0 + r * p;
+    p = 1.0 / 720.0 + r * p;
+    p = 1.0 / 120.0 + r * p;
+    p = 1.0 / 24.0 + r * p;
+    p = 1.0 / 6.0 + r * p;
+    p = 0.5 + r * p;
+    p = r + r * r * p;
+    p = 1.0 + p;
+
+    // scale by 2^k
+    return as_double(as_int(p) + k * (std::int64_t(1) << 52));
+}
+
+inline bool cos_in_range ( double x ) { return std::fabs(x) <= 1048576.0; }
+inline bool exp_in_range ( double x ) { return x >= -708.0 && x <= 709.0; }
+
+template <typename Core, typename InRange, typename Fallback>
+inline void apply ( double const* x, double* y, std::size_t n,
+                    Core core, InRange ok, Fallback fallback )
+{
+    std::size_t i = 0;
+    for ( ; i + WIDTH <= n; i += WIDTH ) {
+        vdouble v;
+        std::memcpy(&v, x + i, sizeof v);
+        bool inside = true;
+        for ( std::size_t l = 0; l < WIDTH; ++l ) { inside &= ok(v[l]); }
+        if (inside) {
+            v = core(v);
+            std::memcpy(y + i, &v, sizeof v);
+        } else {
+            for ( std::size_t l = 0; l < WIDTH; ++l )
+                { y[i + l] = ok(x[i + l]) ? core(x[i + l]) : fallback(x[i + l]); }
+        }
+    }
+    for ( ; i < n; ++i )
+        { y[i] = ok(x[i]) ? core(x[i]) : fallback(x[i]); }
+}
+
+}
+
+template <accuracy A = accuracy::precise>
+inline auto cos ( double x ) -> double
+{
+    return detail::cos_in_range(x)
+        ? detail::cos<A,double,std::int64_t>(x) : std::cos(x);
+}
+
+template <accuracy A = accuracy::precise>
+inline auto exp ( double x ) -> double
+{
+    return detail::exp_in_range(x)
+        ? detail::exp<A,double,std::int64_t>(x) : std::exp(x);
+}
+
+inline auto sqrt ( double x ) -> double { return std::sqrt(x); }
+
+/** y[i] = cos(x[i]) for i < n; x and y may alias. */
+inline void cos ( double const* x, double* y, std::size_t n,
+                  accuracy a = accuracy::precise )
+{
+    using namespace detail;
+    auto fallback = [](double x) { return std::cos(x); };
+    auto ok = [](double x) { return cos_in_range(x); };
+    if (a == accuracy::precise) {
+        struct { double operator() ( double x ) { return detail::cos<accuracy::precise,double,std::int64_t>(x); }
+                 vdouble operator() ( vdouble x ) { return detail::cos<accuracy::precise,vdouble,vint64>(x); } } core;
+        apply(x, y, n, core, ok, fallback);
+    } else {
+        struct { double operator() ( double x ) { return detail::cos<accuracy::fast,double,std::int64_t>(x); }
+                 vdouble operator() ( vdouble x ) { return detail::cos<accuracy::fast,vdouble,vint64>(x); } } core;
+        apply(x, y, n, core, ok, fallback);
+    }
+}
+
+/** y[i] = exp(x[i]) for i < n; x and y may alias. */
+inline void exp ( double const* x, double* y, std::size_t n,
+                  accuracy a = accuracy::precise )
+{
+    using namespace detail;
+    auto fallback = [](double x) { return std::exp(x); };
+    auto ok = [](double x) { return exp_in_range(x); };
+    if (a == accuracy::precise) {
+        struct { double operator() ( double x ) { return detail::exp<accuracy::precise,double,std::int64_t>(x); }
+                 vdouble operator() ( vdouble x ) { return detail::exp<accuracy::precise,vdouble,vint64>(x); } } core;
+        apply(x, y, n, core, ok, fallback);
+    } else {
+        struct { double operator() ( double x ) { return detail::exp<accuracy::fast,double,std::int64_t>(x); }
+                 vdouble operator() ( vdouble x ) { return detail::exp<accuracy::fast,vdouble,vint64>(x); } } core;
+        apply(x, y, n, core, ok, fallback);
+    }
+}
+
+/** y[i] = sqrt(x[i]) for i < n; correctly rounded in either mode. */
+inline void sqrt ( double const* x, double* y, std::size_t n )
+{
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    for ( ; i + 2 <= n; i += 2 )
+        { _mm_storeu_pd(y + i, _mm_sqrt_pd(_mm_loadu_pd(x + i))); }
+#endif
+    for ( ; i < n; ++i ) { y[i] = std::sqrt(x[i]); }
+}
+
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+#endif
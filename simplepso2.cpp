@@ -1,8 +1,19 @@
+#include "logger.hpp"
+#include "philox.hpp"
+#include "population.hpp"
+#include "probe.hpp"
+#include "runnables.hpp"
+#include "stop.hpp"
 #include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <random>
+#include <thread>
 #include <typeinfo>
 #include <vector>
 
@@ -20,8 +31,7 @@ double wd;
 long k = 0;
 long t = 0;
 long d = 200;
-std::mt19937 rng;
-std::uniform_real_distribution<> dis;
+philox rng;
 std::vector<std::vector<double>> x;
 std::vector<std::vector<double>> v;
 std::vector<std::vector<double>> p;
@@ -29,6 +39,17 @@ std::vector<double> f;
 std::vector<double> g;
 double fg;
 
+// worker threads; particles are handed out in contiguous static blocks, or
+// `chunk` at a time from a shared counter when dynamic is set
+long T = std::max(1U, std::thread::hardware_concurrency());
+bool dynamic = false;
+long chunk = 1;
+// deadline and stop requests; looked at once per iteration
+stop_token stop;
+// per-worker phase times and counters, with -DPSO_PROBES; the last slot is
+// written by whichever worker runs the reduction
+probe::summary profile;
+
 double cost( std::vector<double> const& );
 void initialize();
 void optimize();
@@ -39,11 +60,17 @@ using velocity = std::vector<double>;
 
 position& operator+= (position& l, velocity const& r);
 
-int main()
+int main( int argc, char* argv[] )
 {
+    // simplepso2 [threads [static|dynamic [seconds]]]
+    if (argc > 1) { T = std::max(1L, std::atol(argv[1])); }
+    if (argc > 2) { dynamic = std::strcmp(argv[2], "dynamic") == 0; }
+    if (argc > 3) { stop.time_limit(std::atof(argv[3])); }
+
     initialize();
     optimize();
     report();
+    profile.print(std::cerr);
 
     return 0;
 }
@@ -64,30 +91,27 @@ void initialize()
     // b. Set counters k=0, t=0. Set random number seed
     k = 0;
     t = 0;
-    rng.seed(std::random_device()());
+    rng = philox(std::random_device()());
 
     // c. Randomly initialize particle positions  in  for i=1,... , p
-    x.resize(P);
-    dis.param(std::uniform_real_distribution<>::param_type(-600.0, 600.0));
-    for ( auto& xk : x )
+    x.assign(P, std::vector<double>(N));
+    for ( auto i = 0U; i < x.size(); ++i )
     {
-        std::generate_n(std::back_inserter(xk), N, [](){
-            return dis(rng);
-        });
+        rng.fill(i, 0, philox::POSITION, x[i].data(), N);
+        for ( auto& xk : x[i] ) { xk = -600.0 + xk * 1200.0; }
     }
 
     // d. Randomly initialize particle velocities  for i=1,..., p
-    v.resize(P);
-    dis.param(std::uniform_real_distribution<>::param_type(-vmax, vmax));
-    for ( auto& vk : v )
+    v.assign(P, std::vector<double>(N));
+    for ( auto i = 0U; i < v.size(); ++i )
     {
-        std::generate_n(std::back_inserter(vk), N, [](){
-            return dis(rng);
-        });
+        rng.fill(i, 0, philox::VELOCITY, v[i].data(), N);
+        for ( auto& vk : v[i] ) { vk = -vmax + vk * (vmax + vmax); }
     }
     
     // e. Evaluate cost function values using design space coordinates for i=1,..., p
     std::transform(x.cbegin(), x.cend(), std::back_inserter(f), cost);
+    k += P;
 
     // f. Set and for i=1,..., p
     std::copy(x.cbegin(), x.cend(), std::back_inserter(p));
@@ -99,9 +123,7 @@ void initialize()
     std::advance(i, std::distance(f.cbegin(), best));
     g = *i;
 
-    std::cout << fg << ": ";
-    std::copy(f.cbegin(), f.cend(), std::ostream_iterator<double>(std::cout, " "));
-    std::cout << std::endl;
+    logger::standard().write("initial", k, fg);
 }
 
 double cost( std::vector<double> const& xk )
@@ -117,81 +139,143 @@ double cost( std::vector<double> const& xk )
             return prod * std::cos(x / std::sqrt(++i));
         }
     );
-    ++k;
     return cost1 - cost2 + 1.0;
 }
 
+/** Synchronous PSO on T persistent threads.
+ *
+ *  Each iteration every worker moves, evaluates and updates the personal
+ *  best of its share of the particles against the global best of the
+ *  previous iteration, and keeps the minimum (f, i) of its share and its
+ *  evaluation count in its own cache line. The last worker to reach the
+ *  barrier reduces those into fg/g and k and runs the decay and
+ *  termination steps before the next iteration starts. Ties go to the
+ *  lowest particle index and the random numbers depend only on (particle,
+ *  iteration), so the run is the same for any T and either schedule.
+ */
 void optimize()
 {
-    dis.param(std::uniform_real_distribution<>::param_type(0.0, 1.0));
+    struct alignas(64) local_best { double f; std::size_t i; long evaluations; };
+    auto const n = x.size();
+    auto const workers = std::size_t(std::min<long>(T, long(n)));
+    aligned_vector<local_best> best(workers);
+    std::atomic<std::size_t> next(0);
+    auto iteration = 1L;
+    auto done = false;
+    probe::board probes(workers + 1);
 
-    while (true)
-    {
-        for ( auto i = 0U; i < x.size(); ++i )
-        {
+    auto reduce = [&]() {
+        auto best_i = std::min_element(best.cbegin(), best.cend(),
+            [](local_best const& l, local_best const& r) {
+                return l.f < r.f || (l.f == r.f && l.i < r.i);
+        });
+
+        auto evaluations = 0L;
+        for ( auto const& l : best ) { evaluations += l.evaluations; }
+        k += evaluations;
+
+        // f. If  then , for i=1,..., p
+        if ( best_i->f < fg ) {
+            fg = best_i->f;
+            g = x[best_i->i];
+            probes[workers].count(probe::leader_changes);
+            // g. If  was improved in (e), then reset t=0, otherwise increment t
+            t = 0;
+        } else {
+            ++t;
+        }
+        logger::standard().write("iteration", iteration, k, fg, w, vmax, t);
+
+        // h. If the maximum number of function evaluations is exceeded, then go to 3
+        if ( k > kmax || fg < 0.1 || stop.charge(evaluations) ) {
+            done = true;
+            return;
+        }
+
+        // i. If t=d, then multiply wk+1 by (1-wd) and  by (1 -νd)
+        if (t == d) {
+            probes[workers].count(probe::decays);
+            w *= wd;
+            vmax *= vd;
+        }
+
+        next.store(0, std::memory_order_relaxed);
+        ++iteration;
+    };
+    barrier sync(workers);
+
+    auto work = [&]( std::size_t id ) {
+        aligned_vector<double> r1(N), r2(N);
+        auto& sheet = probes[id];
+
+        auto update = [&]( std::size_t i, local_best& mine ) {
+            probe::stopwatch clock(sheet);
             auto& xi = x[i];
             auto& vi = v[i];
             auto& pi = p[i];
 
             // a. Update particle velocity vectors  using Eq. (2)
+            rng.fill(i, iteration, philox::COGNITIVE, r1.data(), N);
+            rng.fill(i, iteration, philox::SOCIAL, r2.data(), N);
             auto pk = pi.cbegin(), xj = xi.cbegin(), gk = g.cbegin();
-            //auto r1 = dis(rng), r2 = dis(rng);
+            auto r1k = r1.cbegin(), r2k = r2.cbegin();
             std::transform(vi.cbegin(), vi.cend(), vi.begin(),
-                [&pk,&xj,&gk](double vk){
+                [&pk,&xj,&gk,&r1k,&r2k](double vk){
                     // b. If  for any component, then set that component to its maximum allowable value
-                    auto r1 = dis(rng), r2 = dis(rng);
+                    auto r1 = *r1k++, r2 = *r2k++;
                     auto xk = *xj++;
                     return std::max(-vmax, std::min(vmax, w * vk + c1 * r1 * (*pk++ - xk) + c2 * r2 * (*gk++ - xk)));
                 }
             );
-    
+            clock.lap(probe::velocity);
+
             // c. Update particle position vectors  using Eq. (1)
             std::transform(xi.cbegin(), xi.cend(), vi.cbegin(), xi.begin(), std::plus<double>());
-        }
-    
-        // d. Evaluate cost function values  using design space coordinates  for i=1,..., p
-        // e. If , then ,  for i=1,..., p
-        auto pk = p.begin();
-        std::transform(x.cbegin(), x.cend(), f.cbegin(), f.begin(),
-            [&pk](std::vector<double> const& xk, double fj){
-                auto fk = cost(xk);
-                if (fk < fj) {
-                    std::copy(xk.cbegin(), xk.cend(), pk->begin());
-                    fj = fk;
-                }
-                ++pk;
-                return fj;
-        });
+            clock.lap(probe::position);
 
-        // f. If  then , for i=1,..., p
-        std::cout << fg << ": ";
-        std::copy(f.cbegin(), f.cend(), std::ostream_iterator<double>(std::cout, " "));
-        std::cout << std::endl;
-
-        auto best = std::min_element(f.cbegin(), f.cend());
-        auto i = x.cbegin();
-        std::advance(i, std::distance(f.cbegin(), best));
-        if ( *best < fg ) {
-            fg = *best;
-            g = *i;
-            // g. If  was improved in (e), then reset t=0, otherwise increment t
-            t = 0;
-            //std::cerr << '!';
-        } else {
-            ++t;
-            //std::cerr << '.';
-        }
-
-        // h. If the maximum number of function evaluations is exceeded, then go to 3
-        if ( k > kmax || fg < 0.1 ) break;
+            // d. Evaluate cost function values  using design space coordinates  for i=1,..., p
+            // e. If , then ,  for i=1,..., p
+            auto fk = cost(xi);
+            ++mine.evaluations;
+            sheet.count(probe::evaluations);
+            clock.lap(probe::evaluation);
+            if (fk < f[i]) {
+                sheet.count(probe::improvements);
+                std::copy(xi.cbegin(), xi.cend(), pi.begin());
+                f[i] = fk;
+            }
+            if (f[i] < mine.f) {
+                mine.f = f[i];
+                mine.i = i;
+            }
+            clock.lap(probe::best);
+        };
 
-        // i. If t=d, then multiply wk+1 by (1-wd) and  by (1 -νd)
-        if (t == d) {
-            //std::cerr << '?';
-            w *= wd;
-            vmax *= vd;
+        while (!done)
+        {
+            auto& mine = best[id];
+            mine.f = std::numeric_limits<double>::infinity();
+            mine.i = n;
+            mine.evaluations = 0;
+            if (dynamic) {
+                for ( std::size_t b; (b = next.fetch_add(chunk)) < n; ) {
+                    for ( auto i = b; i < std::min(b + chunk, n); ++i ) { update(i, mine); }
+                }
+            } else {
+                for ( auto i = id * n / workers; i < (id + 1) * n / workers; ++i ) { update(i, mine); }
+            }
+            // waiting at the barrier, reduction included, counts as lock wait
+            probe::stopwatch clock(sheet);
+            sync.arrive_and_wait(reduce);
+            clock.lap(probe::lock_wait);
         }
-    }
+    };
+
+    std::vector<std::thread> pool;
+    for ( auto id = 1UL; id < workers; ++id ) { pool.emplace_back(work, id); }
+    work(0);
+    for ( auto& th : pool ) { th.join(); }
+    profile = probes.total();
 }
 
 void report()
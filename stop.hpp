@@ -0,0 +1,120 @@
+#ifndef HPP_STOP
+#define HPP_STOP
+
+#include "cppscript.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <utility>
+
+/** Shared reason for a run to end: an explicit request, a wall-clock
+ *  deadline or an evaluation budget, whichever comes first.
+ *
+ *  Copies share one state, so every worker of an engine holds its own
+ *  handle to the same token. Workers don't consult it per evaluation;
+ *  they charge() it with what they have done since the last look every
+ *  so many updates (see stop_poll), which costs one atomic add and, with
+ *  a deadline, one clock read. A time limit is also armed on the timer
+ *  wheel, which raises the stop flag when it runs out, so loops that only
+ *  look at stop_requested() see it too. Deadline and budget are set
+ *  before the run starts; request_stop() may come from any thread at any
+ *  time.
+ */
+class stop_token
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    stop_token() : state(std::make_shared<shared>()) {}
+
+    void request_stop() const { state->stopped.store(true, std::memory_order_relaxed); }
+    bool stop_requested() const { return state->stopped.load(std::memory_order_relaxed); }
+
+    /** End the run at time t, or `seconds` from now. */
+    void deadline ( clock::time_point t ) const
+    {
+        state->deadline = t;
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(t - clock::now());
+        auto s = state.get();
+        cppscript::clear_timeout(state->alarm);
+        state->alarm = cppscript::set_timeout([s]{ s->stopped.store(true, std::memory_order_relaxed); },
+                                              std::max(std::chrono::milliseconds(0), left));
+    }
+    void time_limit ( double seconds ) const
+    {
+        deadline(clock::now() + std::chrono::duration_cast<clock::duration>(
+                                    std::chrono::duration<double>(seconds)));
+    }
+    /** End the run once more than n evaluations have been charged. */
+    void budget ( long long n ) const { state->budget = n; }
+
+    auto budget() const -> long long { return state->budget; }
+    auto spent() const -> long long { return state->spent.load(std::memory_order_relaxed); }
+
+    /** Charge n more evaluations; true if the run should end. */
+    bool charge ( long long n ) const
+    {
+        if (state->spent.fetch_add(n, std::memory_order_relaxed) + n > state->budget)
+            { request_stop(); }
+        return expired();
+    }
+
+    /** True once stopped or past the deadline; a passed deadline turns
+     *  into a stop request so later checks don't read the clock. */
+    bool expired() const
+    {
+        if (stop_requested()) { return true; }
+        if (state->deadline != clock::time_point::max() && clock::now() >= state->deadline) {
+            request_stop();
+            return true;
+        }
+        return false;
+    }
+
+private:
+    struct shared
+    {
+        shared()
+            : stopped(false), spent(0), budget(std::numeric_limits<long long>::max()),
+              deadline(clock::time_point::max()) {}
+        ~shared() { cppscript::clear_timeout(alarm); }
+        std::atomic<bool> stopped;
+        std::atomic<long long> spent;
+        long long budget;
+        clock::time_point deadline;
+        cppscript::timeout alarm;
+    };
+
+    std::shared_ptr<shared> state;
+};
+
+/** One thread's view of a stop_token: counts evaluations locally and
+ *  charges the token only every `every` of them, so a worker notices a
+ *  stop within `every` updates at the cost of one atomic add per batch.
+ *  Up to every - 1 evaluations per worker may go uncharged at the end. */
+class stop_poll
+{
+public:
+    explicit stop_poll ( stop_token t = stop_token(), unsigned every = 64 )
+        : t(std::move(t)), every(every ? every : 1), pending(0) {}
+
+    /** One more evaluation; true if the run should end. */
+    bool operator() ()
+    {
+        if (++pending < every) { return false; }
+        auto n = pending;
+        pending = 0;
+        return t.charge(n);
+    }
+
+    auto token() const -> stop_token const& { return t; }
+
+private:
+    stop_token t;
+    unsigned every;
+    unsigned pending;
+};
+
+#endif
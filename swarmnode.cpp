@@ -0,0 +1,20 @@
+#include "remote.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <system_error>
+
+int main (int argc, char** argv)
+{
+    // swarmnode host port: serve one coordinator connection
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " host port" << std::endl;
+        return 1;
+    }
+    try {
+        serve(net::connect(argv[1], std::uint16_t(atoi(argv[2]))));
+    } catch (std::system_error const& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
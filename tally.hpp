@@ -0,0 +1,50 @@
+#ifndef HPP_TALLY
+#define HPP_TALLY
+
+#include "population.hpp"
+#include <atomic>
+#include <cstddef>
+
+/** Event counter split into one cache line per thread, summed on demand.
+ *
+ *  Every slot has a single writer, so add() is a plain load and store on
+ *  a line nobody else writes: no locked read-modify-write and no line
+ *  bouncing between cores. total() can run at any time and sums the
+ *  latest value of every slot.
+ */
+class tally
+{
+public:
+    explicit tally ( std::size_t slots ) : counts(slots ? slots : 1) {}
+
+    /** Only ever called by the one thread that owns `slot`. */
+    void add ( std::size_t slot, long long n = 1 )
+    {
+        auto& c = counts[slot].count;
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    auto operator[] ( std::size_t slot ) const -> long long
+        { return counts[slot].count.load(std::memory_order_relaxed); }
+
+    auto total() const -> long long
+    {
+        auto sum = 0LL;
+        for ( auto const& c : counts ) { sum += c.count.load(std::memory_order_relaxed); }
+        return sum;
+    }
+
+    auto size() const -> std::size_t { return counts.size(); }
+
+private:
+    struct slot
+    {
+        slot() : count(0) {}
+        std::atomic<long long> count;
+        char padding[64 - sizeof(std::atomic<long long>)];
+    };
+
+    aligned_vector<slot> counts;
+};
+
+#endif
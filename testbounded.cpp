@@ -0,0 +1,102 @@
+#include "check.hpp"
+#include "pso.hpp"
+#include "philox.hpp"
+#include "recorder.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Bounded evaluation: a finished cost is the exact one, an abandoned cost
+ * is never below the bound, a swarm that abandons runs the same course as
+ * one that evaluates everything, and a recorded swarm keeps exact costs;
+ * in fast math too. */
+
+/* seconds for `sweeps` sweeps of a fixed-seed swarm; its best cost in *best */
+double run ( objective* f, std::size_t d, long sweeps, bool abandon, double* best )
+{
+    std::unique_ptr<swarm> s(new swarm(d, f, {32,2.0,2.0,1.0,1.0,0.95,0.5,0.95,200}, 5));
+    s->abandon(abandon);
+    auto start = std::chrono::steady_clock::now();
+    s->initialize();
+    for ( auto i = 0L; i < sweeps; ++i ) { s->step(); }
+    *best = s->cost(s->leading());
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* f by name, or its fast-math form when the name ends in ":fast" */
+objective* make ( std::string const& name )
+{
+    if (name == "rastrigin:fast") { return new rastrigin(simd::accuracy::fast); }
+    if (name == "griewangk:fast") { return new griewangk(simd::accuracy::fast); }
+    return make_objective(name);
+}
+
+int main (int argc, char** argv)
+{
+    long const sweeps = argc > 1 ? atol(argv[1]) : 300;
+    std::size_t const d = 1000;
+    auto failed = 0;
+
+    char const* names[] = { "sphere", "rastrigin", "griewangk", "rosenbrock", "dixon_price",
+                            "rastrigin:fast", "griewangk:fast" };
+    std::vector<double> x(d);
+    philox rng(11);
+    for ( auto name : names ) {
+        std::unique_ptr<objective> f(make(name));
+        auto exact = true, bounded = true;
+        for ( auto i = 0; i < 200; ++i ) {
+            // a tenth of the domain, or close to the optimum where the
+            // terms are smallest and fast math matters most
+            rng.fill(i, 0, philox::POSITION, x.data(), d);
+            auto lo = f->domain(0).first, hi = f->domain(0).second;
+            auto scale = i % 2 ? 1e4 : 10;
+            for ( auto& v : x ) { v = (lo + v * (hi - lo)) / scale; }
+            auto cost = (*f)(x.data(), x.data() + d);
+            exact = exact && f->bounded(x.data(), x.data() + d, cost * 1.5 + 1) == cost
+                          && f->bounded(x.data(), x.data() + d, std::nextafter(cost, 2 * cost + 1)) == cost
+                          && f->bounded(x.data(), x.data() + d, std::numeric_limits<double>::infinity()) == cost;
+            auto bound = cost / 8;
+            auto low = f->bounded(x.data(), x.data() + d, bound);
+            bounded = bounded && low >= bound && low <= cost;
+        }
+        std::cout << "     " << name << std::endl;
+        failed += !check("a finished cost is exact", exact);
+        failed += !check("an abandoned cost is between the bound and the cost", bounded);
+    }
+
+    for ( auto name : names ) {
+        double full, cut;
+        auto slow = run(make(name), d, sweeps, false, &full);
+        auto fast = run(make(name), d, sweeps, true, &cut);
+        std::cout << "     " << name << ": " << slow / sweeps * 1e3 << " ms/sweep in full, "
+                  << fast / sweeps * 1e3 << " ms/sweep bounded" << std::endl;
+        failed += !check("the same run either way", full == cut);
+    }
+
+    {
+        std::string const path = "testbounded.traj";
+        std::size_t const small = 64;
+        std::unique_ptr<swarm> s(new swarm(small, new sphere(), {16,2.0,2.0,1.0,1.0,0.95,0.5,0.95,200}, 5));
+        recorder tape(path, 16, small);
+        s->record_to(&tape);
+        s->abandon(true);
+        s->initialize();
+        for ( auto i = 0; i < 50; ++i ) { s->step(); }
+        tape.close();
+        trajectory t(path);
+        auto last = t[t.size() - 1];
+        sphere f;
+        auto exact = true;
+        for ( auto i = 0UL; i < 16; ++i )
+            { exact = exact && last.cost(i) == f(last.position(i), last.position(i) + small); }
+        failed += !check("a recorded swarm keeps every exact cost", exact);
+        std::remove(path.c_str());
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,164 @@
+#include "check.hpp"
+#include "evalcache.hpp"
+#include "philox.hpp"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Exercises the evaluation cache: hits within the tolerance, eviction,
+ * threads and forked processes sharing one file, the cost of a hit, and
+ * refusing a file made for another problem. */
+
+/* sphere that counts its calls */
+class counted : public sphere
+{
+public:
+    explicit counted ( std::atomic<long>& calls ) : calls(calls) {}
+    auto operator() ( param a, param b ) const -> double
+    {
+        ++calls;
+        return sphere::operator()(a, b);
+    }
+    void evaluate ( double const* x, std::size_t n, std::size_t d,
+                    std::size_t pitch, double* cost ) const
+        { objective::evaluate(x, n, d, pitch, cost); }
+private:
+    std::atomic<long>& calls;
+};
+
+std::vector<double> points ( std::size_t n, std::size_t d, std::uint64_t seed )
+{
+    std::vector<double> x(n * d);
+    philox rng(seed);
+    for ( std::size_t i = 0; i < n; ++i ) { rng.fill(i, 0, philox::POSITION, &x[i * d], d); }
+    return x;
+}
+
+int main (int argc, char** argv)
+{
+    std::string const path = argc > 1 ? argv[1] : "testcache.cache";
+    std::size_t const n = 200, d = 64;
+    double const tol = 1e-6;
+    auto failed = 0;
+    std::remove(path.c_str());
+
+    std::atomic<long> calls(0);
+    auto x = points(n, d, 1);
+    std::vector<double> cost(n), again(n);
+    sphere exact;
+    {
+        cached_objective f(new counted(calls), "sphere", path, d, tol);
+        f.evaluate(x.data(), n, d, d, cost.data());
+        f.evaluate(x.data(), n, d, d, again.data());
+        failed += !check("second pass is all hits", calls == long(n) && cost == again
+                                                    && f.stats().hits == long(n) && f.stats().misses == long(n));
+
+        // keys are cells of a grid of spacing tol: from the centre of a
+        // cell, a move of tol / 10 stays in it and 3 tol leaves it
+        auto y = x;
+        for ( auto& v : y ) { v = std::round(v / tol) * tol; }
+        f.evaluate(y.data(), n, d, d, again.data());
+        for ( auto& v : y ) { v += tol / 10; }
+        auto before = calls.load();
+        f.evaluate(y.data(), n, d, d, again.data());
+        failed += !check("within the tolerance hits", calls == before);
+        for ( auto& v : y ) { v += 3 * tol; }
+        f.evaluate(y.data(), n, d, d, again.data());
+        failed += !check("beyond the tolerance misses", calls == before + long(n));
+
+        auto start = std::chrono::steady_clock::now();
+        auto const rounds = 200;
+        auto sum = 0.0;
+        for ( auto r = 0; r < rounds; ++r ) {
+            for ( std::size_t i = 0; i < n; ++i ) { sum += f(&x[i * d], &x[i * d] + d); }
+        }
+        auto us = std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now() - start).count()
+                / (rounds * n);
+        std::cout << "     " << us << " us per hit at d = " << d << std::endl;
+        failed += !check("a hit takes microseconds", us < 10.0 && sum > 0);
+    }
+
+    {
+        // every thread evaluates the same points; every answer must be exact
+        cached_objective f(new sphere(), "sphere", path, d, tol);
+        auto z = points(64, d, 2);
+        std::atomic<bool> wrong(false);
+        std::vector<std::thread> pool;
+        for ( auto t = 0; t < 4; ++t ) {
+            pool.emplace_back([&]{
+                for ( auto r = 0; r < 50; ++r ) {
+                    for ( std::size_t i = 0; i < 64; ++i ) {
+                        auto c = f(&z[i * d], &z[i * d] + d);
+                        if (std::abs(c - exact(&z[i * d], &z[i * d] + d)) > 1e-3) { wrong = true; }
+                    }
+                }
+            });
+        }
+        for ( auto& t : pool ) { t.join(); }
+        failed += !check("threads share the table", !wrong);
+    }
+
+    {
+        // a child process fills in new points, the parent finds them
+        auto w = points(n, d, 3);
+        auto pid = ::fork();
+        if (pid == 0) {
+            cached_objective f(new sphere(), "sphere", path, d, tol);
+            std::vector<double> c(n);
+            f.evaluate(w.data(), n, d, d, c.data());
+            ::_exit(0);
+        }
+        ::waitpid(pid, nullptr, 0);
+        calls = 0;
+        cached_objective f(new counted(calls), "sphere", path, d, tol);
+        std::vector<double> c(n);
+        f.evaluate(w.data(), n, d, d, c.data());
+        failed += !check("another process's results persist and hit", calls == 0);
+    }
+
+    {
+        std::string const small = path + ".small";
+        std::remove(small.c_str());
+        cached_objective f(new sphere(), "sphere", small, d, tol, 16);
+        auto many = points(1000, d, 4);
+        std::vector<double> c(1000);
+        f.evaluate(many.data(), 1000, d, d, c.data());
+        auto ok = true;
+        for ( auto i = 0; i < 1000; ++i ) {
+            ok = ok && std::abs(f(&many[i * d], &many[i * d] + d) - exact(&many[i * d], &many[i * d] + d)) < 1e-3;
+        }
+        failed += !check("a full table evicts and stays correct", ok && f.stats().evictions > 0);
+        std::remove(small.c_str());
+    }
+
+    auto refused = false;
+    try { cached_objective f(new sphere(), "sphere", path, d + 1, tol); }
+    catch (std::system_error const&) { refused = true; }
+    failed += !check("a cache for another problem is refused", refused);
+
+    refused = false;
+    try { cached_objective f(new griewangk(), "griewangk", path, d, tol); }
+    catch (std::system_error const&) { refused = true; }
+    failed += !check("a cache for another objective is refused", refused);
+
+    {
+        std::string const other = path + ".fast";
+        { cached_objective f(new rastrigin(), "rastrigin", other, d, tol); }
+        refused = false;
+        try { cached_objective f(new rastrigin(simd::accuracy::fast), "rastrigin", other, d, tol); }
+        catch (std::system_error const&) { refused = true; }
+        failed += !check("a cache made under the other accuracy is refused", refused);
+        std::remove(other.c_str());
+    }
+
+    std::remove(path.c_str());
+    return failed ? 1 : 0;
+}
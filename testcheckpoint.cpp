@@ -0,0 +1,74 @@
+#include "check.hpp"
+#include "pso.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+/* Saves a swarm part way through, resumes it in a fresh swarm with another
+ * seed and expects the same run, to the last bit, as one never stopped. */
+
+swarm* make ( std::uint64_t seed, topology_param t )
+{
+    auto s = new swarm(16, new rastrigin(), {20,2.0,2.0,1.0,1.0,0.95,0.5,0.95,5}, seed);
+    s->connect(t);
+    return s;
+}
+
+bool same ( swarm const& a, swarm const& b )
+{
+    auto x = a.best_solution(), y = b.best_solution();
+    auto equal = x == y && a.evaluations() == b.evaluations() && a.leading() == b.leading();
+    for ( auto i = 0UL; i < a.size(); ++i ) { equal = equal && a.cost(i) == b.cost(i); }
+    return equal;
+}
+
+int main (int argc, char** argv)
+{
+    std::string const path = argc > 1 ? argv[1] : "testcheckpoint.ckpt";
+    long const sweeps = 3000, at = 1234;
+    auto failed = 0;
+
+    for ( auto kind : { topology_param::shape::global, topology_param::shape::small_world } ) {
+        topology_param t { kind, 2, 0.1, kind == topology_param::shape::global ? 0 : 50 };
+        std::unique_ptr<swarm> whole(make(7, t)), first(make(7, t)), second(make(99, t));
+
+        whole->initialize();
+        for ( auto i = 0L; i < sweeps; ++i ) { whole->step(); }
+
+        first->initialize();
+        for ( auto i = 0L; i < at; ++i ) { first->step(); }
+        checkpoint::image img;
+        first->save(img);
+        checkpoint::write(path, img);
+        failed += !check("no temporary left behind", ::access((path + ".tmp").c_str(), F_OK) != 0);
+
+        second->resume(checkpoint::file(path).contents());
+        for ( auto i = at; i < sweeps; ++i ) { second->step(); }
+        failed += !check(kind == topology_param::shape::global ? "resumed global-best run is identical"
+                                                               : "resumed rewired small-world run is identical",
+                         same(*whole, *second));
+    }
+
+    std::unique_ptr<swarm> other(new swarm(8, new rastrigin()));
+    auto refused = false;
+    try { other->resume(checkpoint::file(path).contents()); }
+    catch (std::system_error const&) { refused = true; }
+    failed += !check("a swarm of another shape is refused", refused);
+
+    {
+        checkpoint::writer w(path);
+        for ( auto i = 0; i < 5; ++i ) {
+            checkpoint::image img;
+            img.put(std::int32_t(i));
+            w.submit(std::move(img));
+        }
+    }
+    auto last = checkpoint::file(path).contents().get<std::int32_t>();
+    failed += !check("the writer always writes the last image", last == 4);
+
+    std::remove(path.c_str());
+    return failed ? 1 : 0;
+}
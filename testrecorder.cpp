@@ -0,0 +1,67 @@
+#include "check.hpp"
+#include "pso.hpp"
+#include "recorder.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+/* Records a 64 x 1000 run and reads it back through the mapped reader;
+ * reports the time per sweep next to an unrecorded run of the same swarm
+ * (a measurement, not a check: it depends on the cores the writer gets). */
+
+/* seconds for `sweeps` sweeps of a fixed-seed 64 x 1000 swarm */
+double run ( long sweeps, recorder* tape, swarm** keep = nullptr )
+{
+    auto s = new swarm(1000, new griewangk(), {64,2.0,2.0,1.0,1.0,0.95,0.5,0.95,200}, 42);
+    s->record_to(tape);
+    auto start = std::chrono::steady_clock::now();
+    s->initialize();
+    for ( auto i = 0L; i < sweeps; ++i ) { s->step(); }
+    if (tape) { tape->close(); }
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (keep) { *keep = s; } else { delete s; }
+    return seconds;
+}
+
+int main (int argc, char** argv)
+{
+    long const sweeps = argc > 1 ? atol(argv[1]) : 200;
+    std::string const path = argc > 2 ? argv[2] : "testrecorder.traj";
+    auto failed = 0;
+
+    auto plain = run(sweeps, nullptr);
+    swarm* s = nullptr;
+    recorder tape(path, 64, 1000);
+    auto recorded = run(sweeps, &tape, &s);
+    std::cout << "     " << plain / sweeps * 1e3 << " ms/sweep plain, "
+              << recorded / sweeps * 1e3 << " ms/sweep recorded ("
+              << (recorded / plain - 1) * 100 << "% overhead, "
+              << std::thread::hardware_concurrency() << " cores)" << std::endl;
+
+    {
+        trajectory t(path);
+        failed += !check("one frame per sweep and one for initialize",
+                         t.size() == std::size_t(sweeps + 1) && t.particles() == 64 && t.dimensions() == 1000);
+        auto ordered = true;
+        for ( auto i = 0UL; i < t.size(); ++i ) { ordered = ordered && t[i].sweep() == long(i); }
+        failed += !check("frames in sweep order", ordered);
+        failed += !check("find by sweep", t.find(sweeps / 2) == std::size_t(sweeps / 2)
+                                          && t.find(sweeps + 5) == t.size());
+        auto last = t[t.size() - 1];
+        auto same = last.evaluations() == s->evaluations();
+        for ( auto i = 0UL; i < s->size(); ++i ) {
+            same = same && last.best_cost(i) == s->cost(i)
+                        && std::equal(s->position(i), s->position(i) + 1000, last.position(i))
+                        && std::equal(s->velocity(i), s->velocity(i) + 1000, last.velocity(i));
+        }
+        failed += !check("last frame matches the swarm", same);
+    }
+
+    delete s;
+    std::remove(path.c_str());
+    return failed ? 1 : 0;
+}
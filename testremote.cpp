@@ -0,0 +1,153 @@
+#include "check.hpp"
+#include "remote.hpp"
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Localhost harness for the coordinator/worker protocol: every worker is
+ * a forked process connecting back to a listener on a free port. */
+
+std::vector<pid_t> children;
+
+/* How the first worker misbehaves: not at all, by dying without a word
+ * after its first batch, or by stopping (still connected) after setup. */
+enum fault { none, dies, stalls };
+
+/* Start n workers, the first of them with the given fault. */
+std::vector<net::socket> spawn ( net::socket const& l, int n, fault first = none )
+{
+    auto port = net::port(l);
+    for ( auto i = 0; i < n; ++i ) {
+        auto pid = ::fork();
+        if (pid == 0) {
+            auto s = net::connect("127.0.0.1", port);
+            if (first != none && i == 0) {
+                wire::header h;
+                std::vector<char> payload;
+                wire::receive(s.get(), h, payload, UINT32_MAX);    // SETUP
+                if (first == stalls) { ::raise(SIGSTOP); }
+                wire::receive(s.get(), h, payload, UINT32_MAX);    // first EVAL
+                ::raise(SIGKILL);
+            }
+            serve(std::move(s));
+            ::_exit(0);
+        }
+        children.push_back(pid);
+    }
+    std::vector<net::socket> workers;
+    for ( auto i = 0; i < n; ++i ) { workers.push_back(net::accept(l)); }
+    return workers;
+}
+
+void reap()
+{
+    // a stopped worker never exits by itself
+    for ( auto pid : children ) { ::kill(pid, SIGCONT); }
+    for ( auto pid : children ) { ::waitpid(pid, nullptr, 0); }
+    children.clear();
+}
+
+int main (int argc, char** argv)
+{
+    auto l = net::listen(0);
+    auto failed = 0;
+
+    std::size_t const n = 200000, d = 8;
+    std::vector<double> x(n * d), expect(n), got(n);
+    std::mt19937_64 gen(7);
+    std::uniform_real_distribution<double> u(-5.12, 5.12);
+    for ( auto& v : x ) { v = u(gen); }
+    rastrigin local;
+    local.evaluate(x.data(), n, d, d, expect.data());
+
+    {
+        remote_objective f { spawn(l, 2), "rastrigin", d, 1024, 4 };
+        auto t0 = std::chrono::steady_clock::now();
+        f.evaluate(x.data(), n, d, d, got.data());
+        auto s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        failed += !check("remote batch matches local evaluation", got == expect);
+        std::cout << "     " << long(n / s) << " evaluations/s over 2 workers" << std::endl;
+        failed += !check("at least 100k evaluations/s", n / s >= 100000);
+        failed += !check("single evaluation", f(x.data(), x.data() + d) == expect[0]);
+    }
+    reap();
+
+    {
+        std::fill(got.begin(), got.end(), 0.0);
+        remote_objective f { spawn(l, 3, dies), "rastrigin", d, 1024, 4 };
+        f.evaluate(x.data(), n, d, d, got.data());
+        failed += !check("lost worker's batches are redone", got == expect);
+        failed += !check("lost worker is retired", f.workers() == 2);
+    }
+    reap();
+
+    {
+        std::fill(got.begin(), got.end(), 0.0);
+        auto workers = spawn(l, 1);
+        ::kill(children[0], SIGKILL);
+        remote_objective f { std::move(workers), "rastrigin", d, 1024, 4 };
+        f.evaluate(x.data(), n, d, d, got.data());
+        failed += !check("falls back to local evaluation with no workers", got == expect);
+    }
+    reap();
+
+    {
+        std::fill(got.begin(), got.end(), 0.0);
+        remote_objective f { spawn(l, 3, stalls), "rastrigin", d, 1024, 4, std::chrono::milliseconds(300) };
+        auto t0 = std::chrono::steady_clock::now();
+        f.evaluate(x.data(), n, d, d, got.data());
+        auto s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        failed += !check("stopped worker's batches are redone", got == expect);
+        failed += !check("stopped worker is retired at its deadline", f.workers() == 2 && s < 5.0);
+    }
+    reap();
+
+    {
+        remote_islands r { spawn(l, 3, stalls), "griewangk", 16, 10, 1, std::chrono::milliseconds(300) };
+        auto t0 = std::chrono::steady_clock::now();
+        r();
+        auto s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        failed += !check("remote islands finish without a stopped worker", s < 10.0
+                                                                          && r.best_solution().first < 0.1);
+    }
+    reap();
+
+    {
+        remote_islands r { spawn(l, 3), "griewangk", 16, 10 };
+        r();
+        failed += !check("remote islands reach the target", r.best_solution().first < 0.1);
+        std::cout << "     " << r.evaluations() << " evaluations" << std::endl;
+    }
+    reap();
+
+    {
+        remote_islands r { spawn(l, 2), "rastrigin", 64, 10 };
+        r.stop().time_limit(0.2);
+        auto t0 = std::chrono::steady_clock::now();
+        r();
+        auto s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        failed += !check("remote islands stop at the deadline", s < 1.0);
+    }
+    reap();
+
+    {
+        int pair[2];
+        ::socketpair(AF_UNIX, SOCK_STREAM, 0, pair);
+        net::socket a(pair[0]), b(pair[1]);
+        wire::header h { wire::COST, UINT32_MAX };
+        net::send_all(a.get(), &h, sizeof h);
+        std::vector<char> payload;
+        failed += !check("an oversized frame is refused", !wire::receive(b.get(), h, payload, 1024)
+                                                          && payload.capacity() < 1024);
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,149 @@
+#include "check.hpp"
+#include "shmislands.hpp"
+#include <algorithm>
+#include <cmath>
+#include <csignal>
+#include <iostream>
+#include <limits>
+#include <system_error>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Workers that die while they hold shared state: a global best left
+ * half written, a ring cell claimed but never filled, and an island
+ * killed mid-run. The survivors must carry on either way. */
+
+/* rastrigin, until its process has spent `last` evaluations */
+class dying : public rastrigin
+{
+public:
+    explicit dying ( long last ) : last(last), spent(0) {}
+
+    auto operator() ( param a, param b ) const -> double
+    {
+        count(1);
+        return rastrigin::operator()(a, b);
+    }
+
+    void evaluate ( double const* x, std::size_t n, std::size_t d,
+                    std::size_t pitch, double* cost ) const
+    {
+        count(long(n));
+        rastrigin::evaluate(x, n, d, pitch, cost);
+    }
+
+private:
+    void count ( long n ) const { if ((spent += n) > last) { ::raise(SIGKILL); } }
+
+    long const last;
+    mutable long spent;
+};
+
+/* runs `body` in a child process and waits for it to die */
+template <typename F>
+void in_child ( F body )
+{
+    auto pid = ::fork();
+    if (pid == 0) {
+        body();
+        ::_exit(0);
+    }
+    ::waitpid(pid, nullptr, 0);
+}
+
+int main ()
+{
+    auto failed = 0;
+    std::size_t const d = 16;
+
+    {
+        shm_segment shm(shared_best::bytes(d));
+        shared_best global(d, shm.data(), true);
+        std::vector<double> x(d, 1.0);
+        global.offer(2.0, x.data(), 1);
+
+        // the child's position runs into a page it may not read, so it
+        // faults halfway through its offer
+        auto page = std::size_t(::sysconf(_SC_PAGESIZE));
+        auto p = static_cast<char*>(::mmap(nullptr, 2 * page, PROT_READ | PROT_WRITE,
+                                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        ::mprotect(p + page, page, PROT_NONE);
+        auto torn = reinterpret_cast<double*>(p + page) - d / 2;
+        std::fill(torn, torn + d / 2, 3.0);
+        in_child([&]{ global.offer(1.0, torn, 2); });
+        ::munmap(p, 2 * page);
+
+        std::vector<double> out(d);
+        auto c = 0.0;
+        failed += !check("a held best cannot be read without waiting", !global.try_read(out.data(), c));
+        failed += !check("another writer's number releases nothing", !global.recover(1, 2.0, x.data()));
+        failed += !check("the dead writer's number releases the best", global.recover(2, 2.0, x.data()));
+        failed += !check("the pair read before is put back", global.try_read(out.data(), c)
+                                                             && c == 2.0 && out == x);
+        std::fill(x.begin(), x.end(), 0.5);
+        failed += !check("the next offer lands", global.offer(0.5, x.data(), 1)
+                                                 && global.read(out.data()) == 0.5 && out == x);
+    }
+
+    {
+        std::size_t const capacity = 4;
+        shm_segment shm(shm_ring::bytes(capacity, d));
+        shm_ring ring(shm.data(), capacity, d, true);
+        auto push = [&](double c, unsigned writer) {
+            return ring.try_push([&](double& cost, double* x) {
+                cost = c;
+                std::fill(x, x + d, c);
+            }, writer);
+        };
+        auto got = std::vector<double>();
+        auto pop = [&]() {
+            return ring.try_pop([&](double cost, double const* x) {
+                got.push_back(x[d - 1] == cost ? cost : -1.0);
+            });
+        };
+
+        in_child([&]{
+            ring.try_push([](double& cost, double*) {
+                cost = 7.0;
+                ::raise(SIGKILL);
+            }, 3);
+        });
+        push(1.0, 1);
+        failed += !check("a cell claimed by a dead writer holds the reader up", !pop());
+        failed += !check("its writer number gives it up", ring.recover(3) == 1 && ring.recover(3) == 0);
+        failed += !check("the reader passes over it", pop() && got == std::vector<double>{ 1.0 });
+
+        got.clear();
+        auto lap = true;
+        for ( auto i = 0UL; i < 2 * capacity; ++i ) { lap = lap && push(double(i), 1) && pop(); }
+        failed += !check("the ring keeps going round", lap && got.size() == 2 * capacity && got.back() == 2 * capacity - 1);
+    }
+
+    {
+        unsigned const k = 4;
+        migration_param m { 1, 2, migration_param::topology::full, migration_param::replacement::worse };
+        process_archipelago a { k, d, [](unsigned id) {
+            return new swarm(int(d), id == 1 ? new dying(20000) : new rastrigin(), {32,2.0,2.0,1.0,1.0,0.95,0.5,0.95,200}, id);
+        }, m, 9 };
+        a.stop().time_limit(1.0);
+        a();
+        auto survivors = std::numeric_limits<double>::infinity();
+        for ( auto i = 0U; i < k; ++i ) { if (i != 1) { survivors = std::min(survivors, a.island_cost(i)); } }
+        failed += !check("an island killed mid-run is counted as failed", a.failures() == 1);
+        failed += !check("the others finish and publish their best",
+                         std::isfinite(survivors) && a.best_solution().first <= survivors);
+    }
+
+    {
+        auto refused = false;
+        try { process_archipelago a(shm_ring::WRITERS, d, [](unsigned) { return new swarm(int(d)); },
+                                    migration_param { 1, 1, migration_param::topology::ring,
+                                                      migration_param::replacement::worse }); }
+        catch (std::system_error const&) { refused = true; }
+        failed += !check("more islands than writer numbers are refused", refused);
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+#include "check.hpp"
+#include "cppscript.hpp"
+#include "philox.hpp"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace cppscript;
+
+/* The timer wheel under thousands of timers: every kept timeout fires
+ * once, no cancelled callback runs once clear_* has returned, dropping a
+ * handle cancels its timer and nothing is left on the wheel at the end. */
+
+/* what one timer's callback saw */
+struct tally
+{
+    std::atomic<int> runs;
+    std::atomic<bool> cleared;
+    std::atomic<int> late;
+};
+
+int main (int argc, char** argv)
+{
+    std::size_t const n = argc > 1 ? std::size_t(atol(argv[1])) : 5000;
+    auto failed = 0;
+    philox rng(3);
+    std::vector<double> u(2 * n);
+    rng.fill(0, 0, philox::POSITION, u.data(), u.size());
+
+    std::unique_ptr<tally[]> seen(new tally[n]);
+    for ( auto i = 0UL; i < n; ++i ) {
+        seen[i].runs = 0;
+        seen[i].cleared = false;
+        seen[i].late = 0;
+    }
+    // a callback that can stay a while, so clears catch it in flight
+    auto body = [&seen](std::size_t i, bool dwell) {
+        return [&seen,i,dwell]{
+            if (seen[i].cleared.load()) { ++seen[i].late; }
+            ++seen[i].runs;
+            if (dwell) { std::this_thread::sleep_for(std::chrono::microseconds(20)); }
+        };
+    };
+
+    {
+        // timeouts due within 200 ms; every other one cleared at a random
+        // moment before, during or after its run
+        auto start = std::chrono::steady_clock::now();
+        std::vector<timeout> t;
+        t.reserve(n);
+        for ( auto i = 0UL; i < n; ++i )
+            { t.push_back(set_timeout(body(i, true), std::chrono::milliseconds(1 + int(u[i] * 200)))); }
+        for ( auto i = 0UL; i < n; i += 2 ) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds(int(u[n + i] * 250000)));
+            clear_timeout(t[i]);
+            seen[i].cleared = true;
+        }
+        std::this_thread::sleep_until(start + std::chrono::milliseconds(400));
+
+        auto once = true;
+        auto late = 0;
+        for ( auto i = 1UL; i < n; i += 2 ) { once = once && seen[i].runs == 1; }
+        for ( auto i = 0UL; i < n; i += 2 ) { late += seen[i].late + (seen[i].runs > 1); }
+        std::cout << "     " << n << " timeouts" << std::endl;
+        failed += !check("every kept timeout fires once", once);
+        failed += !check("no cleared timeout runs after clear_timeout returns", late == 0);
+    }
+
+    for ( auto i = 0UL; i < n; ++i ) {
+        seen[i].runs = 0;
+        seen[i].cleared = false;
+    }
+    {
+        // intervals of 10 to 50 ms, cleared one by one while all are going
+        std::vector<interval> t;
+        t.reserve(n);
+        for ( auto i = 0UL; i < n; ++i )
+            { t.push_back(set_interval(body(i, false), 10 + int(u[i] * 40))); }
+        std::this_thread::sleep_for(std::chrono::milliseconds(150));
+        for ( auto i = 0UL; i < n; ++i ) {
+            clear_interval(t[i]);
+            seen[i].cleared = true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        auto ran = true;
+        auto late = 0;
+        for ( auto i = 0UL; i < n; ++i ) {
+            ran = ran && seen[i].runs > 0;
+            late += seen[i].late;
+        }
+        std::cout << "     " << n << " intervals" << std::endl;
+        failed += !check("every interval runs", ran);
+        failed += !check("no interval runs after clear_interval returns", late == 0);
+    }
+
+    {
+        std::atomic<bool> fired(false);
+        { auto t = set_timeout([&fired]{ fired = true; }, 20); }
+        auto i = set_interval([&fired]{ fired = true; }, 5);
+        i = interval();
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+        failed += !check("a dropped or overwritten handle cancels its timer", !fired);
+    }
+
+    failed += !check("nothing is left on the wheel", timer_wheel::instance().size() == 0);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,225 @@
+#ifndef HPP_TOPOLOGY
+#define HPP_TOPOLOGY
+
+#include "philox.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** Undirected neighbourhood graph in compressed sparse row form: the
+ *  neighbours of i are targets[offsets[i] .. offsets[i+1]), sorted and
+ *  without i itself, all in two flat arrays. */
+class graph
+{
+public:
+    graph() : offsets(1, 0) {}
+
+    /** From an edge list over n vertices; duplicates and loops are dropped. */
+    graph ( std::size_t n, std::vector<std::pair<std::size_t,std::size_t>> edges )
+        : offsets(n + 1, 0)
+    {
+        for ( auto& e : edges ) { if (e.first > e.second) { std::swap(e.first, e.second); } }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+        edges.erase(std::remove_if(edges.begin(), edges.end(),
+            [](std::pair<std::size_t,std::size_t> const& e) { return e.first == e.second; }), edges.end());
+
+        for ( auto const& e : edges ) { ++offsets[e.first + 1]; ++offsets[e.second + 1]; }
+        for ( std::size_t i = 0; i < n; ++i ) { offsets[i + 1] += offsets[i]; }
+        targets.resize(offsets[n]);
+        auto fill = std::vector<std::size_t>(offsets.begin(), offsets.end() - 1);
+        for ( auto const& e : edges ) {
+            targets[fill[e.first]++] = e.second;
+            targets[fill[e.second]++] = e.first;
+        }
+        for ( std::size_t i = 0; i < n; ++i )
+            { std::sort(targets.begin() + offsets[i], targets.begin() + offsets[i + 1]); }
+    }
+
+    auto size() const -> std::size_t { return offsets.size() - 1; }
+    auto degree ( std::size_t i ) const -> std::size_t { return offsets[i + 1] - offsets[i]; }
+    auto begin ( std::size_t i ) const -> std::size_t const* { return targets.data() + offsets[i]; }
+    auto end ( std::size_t i ) const -> std::size_t const* { return targets.data() + offsets[i + 1]; }
+
+private:
+    std::vector<std::size_t> offsets;
+    std::vector<std::size_t> targets;
+};
+
+/** Which neighbourhood a swarm uses and how often it is redrawn. */
+struct topology_param
+{
+    enum class shape { global, ring, von_neumann, star, regular, small_world, scale_free };
+
+    shape kind;
+    /* ring/small world: neighbours on each side; regular: degree;
+     * scale free: links per new vertex */
+    std::size_t k;
+    /* small world: rewiring probability */
+    double p;
+    /* redraw the graph every this many sweeps; 0 keeps the first one */
+    long rewire;
+
+    /** Parse "global", "ring", "von_neumann", "star", "regular",
+     *  "small_world" or "scale_free"; false for anything else. */
+    static bool parse ( std::string const& name, shape& s )
+    {
+        if (name == "global") { s = shape::global; return true; }
+        if (name == "ring") { s = shape::ring; return true; }
+        if (name == "von_neumann") { s = shape::von_neumann; return true; }
+        if (name == "star") { s = shape::star; return true; }
+        if (name == "regular") { s = shape::regular; return true; }
+        if (name == "small_world") { s = shape::small_world; return true; }
+        if (name == "scale_free") { s = shape::scale_free; return true; }
+        return false;
+    }
+};
+
+namespace topology
+{
+
+using edge_list = std::vector<std::pair<std::size_t,std::size_t>>;
+
+/* Uniform draws for generation round `round`, from the TOPOLOGY stream */
+class draws
+{
+public:
+    draws ( philox const& rng, std::uint64_t round ) : rng(rng), round(round), count(0) {}
+    auto operator() () -> double { return rng(0, round, philox::TOPOLOGY, count++); }
+    /* uniform integer in [0, n) */
+    auto below ( std::size_t n ) -> std::size_t
+        { return std::min(n - 1, std::size_t((*this)() * n)); }
+private:
+    philox const& rng;
+    std::uint64_t round;
+    std::uint64_t count;
+};
+
+/** Each vertex linked to its k nearest on either side. */
+inline auto ring ( std::size_t n, std::size_t k = 1 ) -> graph
+{
+    edge_list e;
+    for ( std::size_t i = 0; i < n; ++i )
+        for ( std::size_t j = 1; j <= k && j < n; ++j ) { e.emplace_back(i, (i + j) % n); }
+    return graph(n, std::move(e));
+}
+
+/** Torus of r rows by c columns, r * c = n with r <= c as close as n
+ *  allows (a ring when n is prime): the vertices left and right in the
+ *  row and above and below in the column, both wrapped. */
+inline auto von_neumann ( std::size_t n ) -> graph
+{
+    auto r = std::max<std::size_t>(1, std::size_t(std::sqrt(double(n))));
+    while (r > 1 && n % r) { --r; }
+    auto c = std::max<std::size_t>(1, n / r);
+    edge_list e;
+    for ( std::size_t i = 0; i < n; ++i ) {
+        auto row = i / c, col = i % c;
+        e.emplace_back(i, row * c + (col + 1) % c);
+        e.emplace_back(i, (row + 1) % r * c + col);
+    }
+    return graph(n, std::move(e));
+}
+
+/** Vertex 0 linked to everyone else, nobody else linked. */
+inline auto star ( std::size_t n ) -> graph
+{
+    edge_list e;
+    for ( std::size_t i = 1; i < n; ++i ) { e.emplace_back(0, i); }
+    return graph(n, std::move(e));
+}
+
+/** Random k-regular graph by the pairing model; falls back to the
+ *  ring lattice of the same degree if no simple pairing turns up. */
+inline auto regular ( std::size_t n, std::size_t k, draws& u ) -> graph
+{
+    if (k >= n || (n * k) % 2) { return ring(n, k / 2); }
+    for ( int attempt = 0; attempt < 100; ++attempt ) {
+        std::vector<std::size_t> stubs;
+        for ( std::size_t i = 0; i < n; ++i ) { stubs.insert(stubs.end(), k, i); }
+        for ( std::size_t i = stubs.size(); i > 1; --i ) { std::swap(stubs[i - 1], stubs[u.below(i)]); }
+        edge_list e;
+        for ( std::size_t i = 0; i < stubs.size(); i += 2 )
+            { e.emplace_back(std::min(stubs[i], stubs[i + 1]), std::max(stubs[i], stubs[i + 1])); }
+        std::sort(e.begin(), e.end());
+        auto simple = std::adjacent_find(e.begin(), e.end()) == e.end()
+            && std::none_of(e.begin(), e.end(),
+                   [](std::pair<std::size_t,std::size_t> const& x) { return x.first == x.second; });
+        if (simple) { return graph(n, std::move(e)); }
+    }
+    return ring(n, k / 2);
+}
+
+/** Watts-Strogatz: the k-ring lattice with each edge's far end moved to
+ *  a random vertex with probability p. */
+inline auto small_world ( std::size_t n, std::size_t k, double p, draws& u ) -> graph
+{
+    edge_list e;
+    for ( std::size_t i = 0; i < n; ++i ) {
+        for ( std::size_t j = 1; j <= k && j < n; ++j ) {
+            auto t = (i + j) % n;
+            if (u() < p) {
+                auto r = u.below(n);
+                if (r != i) { t = r; }
+            }
+            e.emplace_back(i, t);
+        }
+    }
+    return graph(n, std::move(e));
+}
+
+/** Barabasi-Albert: start from a clique of m + 1 vertices, then link
+ *  every new vertex to m existing ones chosen in proportion to degree. */
+inline auto scale_free ( std::size_t n, std::size_t m, draws& u ) -> graph
+{
+    m = std::max<std::size_t>(1, std::min(m, n > 1 ? n - 1 : 1));
+    edge_list e;
+    std::vector<std::size_t> ends;   // every vertex once per incident edge
+    auto seed = std::min(n, m + 1);
+    for ( std::size_t i = 0; i < seed; ++i )
+        for ( std::size_t j = i + 1; j < seed; ++j ) {
+            e.emplace_back(i, j);
+            ends.push_back(i);
+            ends.push_back(j);
+        }
+    for ( std::size_t i = seed; i < n; ++i ) {
+        std::vector<std::size_t> chosen;
+        while (chosen.size() < m) {
+            auto t = ends[u.below(ends.size())];
+            if (std::find(chosen.begin(), chosen.end(), t) == chosen.end()) { chosen.push_back(t); }
+        }
+        for ( auto t : chosen ) {
+            e.emplace_back(t, i);
+            ends.push_back(t);
+            ends.push_back(i);
+        }
+    }
+    return graph(n, std::move(e));
+}
+
+/** The graph described by t over n vertices, for generation round
+ *  `round`; empty for the global topology. */
+inline auto make ( topology_param const& t, std::size_t n, philox const& rng,
+                   std::uint64_t round ) -> graph
+{
+    draws u(rng, round);
+    using shape = topology_param::shape;
+    switch (t.kind) {
+    case shape::global: return graph();
+    case shape::ring: return ring(n, std::max<std::size_t>(1, t.k));
+    case shape::von_neumann: return von_neumann(n);
+    case shape::star: return star(n);
+    case shape::regular: return regular(n, std::max<std::size_t>(2, t.k), u);
+    case shape::small_world: return small_world(n, std::max<std::size_t>(1, t.k), t.p, u);
+    case shape::scale_free: return scale_free(n, std::max<std::size_t>(1, t.k), u);
+    }
+    return graph();
+}
+
+}
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef HPP_TRACE
+#define HPP_TRACE
+
+#include "channel.hpp"
+#include "population.hpp"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+/** Timeline of a threaded run in Chrome trace-event JSON, for
+ *  chrome://tracing or ui.perfetto.dev.
+ *
+ *  Every thread records into a ring of its own, allocated up front:
+ *  recording is a clock read and a few stores, with no allocation, no
+ *  lock and nothing shared with the other writers. A background thread
+ *  drains all rings every `period` and appends the events to the file. A
+ *  full ring drops the event and counts it rather than stall the thread
+ *  being measured. Event names must outlive the tracer (string literals).
+ */
+class tracer
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    /** `slots` rings of `capacity` events each (rounded up to a power of
+     *  two); slot i is written by one thread only. */
+    tracer ( std::string const& path, std::size_t slots, std::size_t capacity = 1 << 16,
+             std::chrono::milliseconds period = std::chrono::milliseconds(50) )
+        : out(path), rings(slots ? slots : 1), period(period),
+          start(clock::now()), first(true), stopping(false)
+    {
+        if (!out) { throw std::system_error(errno, std::generic_category(), path); }
+        for ( auto& r : rings ) { r.reserve(capacity); }
+        out << "{\"traceEvents\":[";
+        for ( auto i = 0UL; i < rings.size(); ++i ) {
+            separate();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << i
+                << ",\"args\":{\"name\":\"slot " << i << "\"}}";
+        }
+        flusher = std::thread(&tracer::flush, this);
+    }
+
+    tracer ( tracer const& ) = delete;
+    tracer& operator= ( tracer const& ) = delete;
+
+    /** Drains what is left and closes the file. */
+    ~tracer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        flusher.join();
+        drain();
+        out << "]}" << std::endl;
+    }
+
+    /** Span `name` starts or ends now on `slot` ... */
+    void begin ( std::size_t slot, char const* name ) { record(slot, name, 'B'); }
+    void end ( std::size_t slot, char const* name ) { record(slot, name, 'E'); }
+    /** ... or an instant event happens. */
+    void mark ( std::size_t slot, char const* name ) { record(slot, name, 'i'); }
+
+    /** Events turned away by a full ring so far. */
+    auto dropped() const -> long long
+    {
+        auto n = 0LL;
+        for ( auto const& r : rings ) { n += r.dropped(); }
+        return n;
+    }
+
+    auto size() const -> std::size_t { return rings.size(); }
+
+    /** Begin and end of one span; does nothing without a tracer. */
+    class span
+    {
+    public:
+        span ( tracer* t, std::size_t slot, char const* name ) : t(t), slot(slot), name(name)
+            { if (t) { t->begin(slot, name); } }
+        span ( span const& ) = delete;
+        span& operator= ( span const& ) = delete;
+        ~span() { if (t) { t->end(slot, name); } }
+    private:
+        tracer* t;
+        std::size_t slot;
+        char const* name;
+    };
+
+private:
+    struct event
+    {
+        char const* name;
+        std::uint64_t ns;
+        char phase;
+    };
+
+    /* written by the slot's thread, drained by the flusher */
+    using ring = spsc_ring<event>;
+
+    void record ( std::size_t slot, char const* name, char phase )
+    {
+        auto& r = rings[slot];
+        auto e = r.claim();
+        if (!e) { return; }
+        e->name = name;
+        e->ns = std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+        e->phase = phase;
+        r.publish();
+    }
+
+    void separate()
+    {
+        if (!first) { out << ','; }
+        first = false;
+    }
+
+    /* on the flusher thread, or after it has stopped */
+    void drain()
+    {
+        for ( auto i = 0UL; i < rings.size(); ++i ) {
+            rings[i].drain([this,i](event const& e) {
+                separate();
+                out << "{\"name\":\"" << e.name << "\",\"ph\":\"" << e.phase
+                    << "\",\"ts\":" << e.ns / 1000 << '.' << char('0' + e.ns / 100 % 10)
+                    << char('0' + e.ns / 10 % 10) << char('0' + e.ns % 10)
+                    << ",\"pid\":0,\"tid\":" << i;
+                if (e.phase == 'i') { out << ",\"s\":\"t\""; }
+                out << '}';
+            });
+        }
+        out.flush();
+    }
+
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            wake.wait_for(lock, period);
+            lock.unlock();
+            drain();
+            lock.lock();
+        }
+    }
+
+    std::ofstream out;
+    aligned_vector<ring> rings;
+    std::chrono::milliseconds const period;
+    clock::time_point const start;
+    bool first;
+    bool stopping;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread flusher;
+};
+
+#endif